@@ -0,0 +1,392 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "pokemon-box-kernels.hh"
+#include "perf-counters.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+//keeps the compiler from dropping a result nothing else reads
+template<typename T>
+void keep(const T& x) {
+    asm volatile("" : : "g"(&x) : "memory");
+}
+
+//what the kernels run on, either the bundled saves or seeded random data of the same shape
+struct bench_input {
+    std::string name;
+    std::vector<pokemon_gen3_format> files;
+    //the checksummed part of every section of every file
+    std::vector<std::span<const std::byte>> sections;
+    size_t section_bytes = 0;
+    //encrypted, with matching checksums
+    std::vector<pokemon_box> pokemon;
+    std::vector<uint16_t> species;
+    std::vector<uint32_t> experience;
+    std::vector<std::array<char, 10>> nicknames;
+
+    void add_sections() {
+        for (auto& f: files) {
+            for (auto* save: {&f.a, &f.b}) {
+                for (auto& s: save->sections) {
+                    if (s.section_id < num_sections) {
+                        sections.push_back(std::span(s.data).first(section_lengths[s.section_id]));
+                        section_bytes += sections.back().size();
+                    }
+                }
+            }
+        }
+    }
+
+    void add_pokemon(const pokemon_box& encrypted) {
+        auto decoded = encrypted.decoded();
+        pokemon.push_back(encrypted);
+        species.push_back(decoded.national_id());
+        experience.push_back(decoded.growth.experience);
+        nicknames.push_back(decoded.nickname);
+    }
+};
+
+//every valid save below paths, with the party and pc of its latest save
+bench_input saves_input(const std::vector<std::string>& paths) {
+    bench_input in;
+    in.name = "saves";
+    auto filenames = collect_save_files(paths);
+    for (auto& filename: filenames) {
+        auto m = mmap_file(filename, mmap_mode::read_only);
+        pokemon_gen3_format f;
+        try {
+            auto d = save_payload(m.data);
+            std::memcpy(&f, d.data(), sizeof(f));
+            f.check();
+        } catch (const std::runtime_error&) {
+            continue;
+        }
+        in.files.push_back(f);
+    }
+    for (auto& f: in.files) {
+        //every file here passed check(), which picks the slot the game would load
+        auto& save = f.check();
+        auto team_items_section = static_cast<section_team_items&>(save.get_section_by_id(section_type::team_items));
+        for (auto& p: team_items_section.get_pokemon_party(f.game_version(save))) {
+            in.add_pokemon(p);
+        }
+        pc_buffer_view(save).for_each([&](const pokemon_box& encrypted, size_t) {
+            if (!encrypted.empty()) {
+                in.add_pokemon(encrypted);
+            }
+        });
+    }
+    in.add_sections();
+    return in;
+}
+
+//random section contents under valid footers, and random pokemon whose checksum field is fixed up
+//to match their decryption
+bench_input synthetic_input(uint64_t seed, size_t num_files, size_t num_pokemon) {
+    bench_input in;
+    in.name = "synthetic";
+    std::mt19937_64 rng(seed);
+    auto fill = [&](std::span<std::byte> s) {
+        for (auto& b: s) {
+            b = static_cast<std::byte>(rng());
+        }
+    };
+    in.files.resize(num_files);
+    for (auto& f: in.files) {
+        fill(span_bytes(std::span(&f, 1)));
+        uint32_t save_index = rng() % 1000;
+        for (auto* save: {&f.a, &f.b}) {
+            size_t rotation = rng() % num_sections;
+            for (size_t i = 0; i < num_sections; i++) {
+                auto& s = save->sections[i];
+                s.section_id = static_cast<section_type>((i + rotation) % num_sections);
+                s.signature = 0x08012025UL;
+                s.save_index = save_index;
+                s.checksum = s.calculate_checksum();
+            }
+            save_index++;
+        }
+    }
+    for (size_t i = 0; i < num_pokemon; i++) {
+        pokemon_box p;
+        fill(span_bytes(std::span(&p, 1)));
+        auto decoded = p.decoded();
+        auto words = span_cast<uint16_t>(decoded.data);
+        p.checksum = std::accumulate(words.begin(), words.end(), uint16_t{0});
+        in.pokemon.push_back(p);
+        in.species.push_back(1 + rng() % (species_table::size - 1));
+        in.experience.push_back(rng() % 1'640'000);
+        std::array<char, 10> nickname;
+        std::string ascii(1 + rng() % nickname.size(), 'A');
+        for (auto& c: ascii) {
+            c = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"[rng() % 52];
+        }
+        string_to_pokemon_string(ascii, nickname);
+        in.nicknames.push_back(nickname);
+    }
+    in.add_sections();
+    return in;
+}
+
+struct bench_case {
+    std::string name;
+    const bench_input* input;
+    //per op, 0 where throughput means nothing
+    double bytes_per_op;
+    //runs the kernel ops times
+    std::function<void(size_t)> run;
+};
+
+struct bench_result {
+    double ns_per_op;
+    size_t ops;
+    perf_sample counters;
+};
+
+//doubles the op count until one round takes round_time, then keeps the fastest of rounds rounds,
+//with the counters of that round
+bench_result run_case(const bench_case& c, std::chrono::nanoseconds round_time, size_t rounds, perf_counters& counters) {
+    using clock = std::chrono::steady_clock;
+    size_t ops = 1;
+    for (;;) {
+        auto start = clock::now();
+        c.run(ops);
+        if (clock::now() - start >= round_time || ops >= size_t{1} << 40) {
+            break;
+        }
+        ops *= 2;
+    }
+    bench_result best{0, ops, {}};
+    for (size_t round = 0; round < rounds; round++) {
+        counters.start();
+        auto start = clock::now();
+        c.run(ops);
+        auto elapsed = clock::now() - start;
+        auto sample = counters.stop();
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+        if (round == 0 || ns < best.ns_per_op) {
+            best.ns_per_op = ns;
+            best.counters = sample;
+        }
+    }
+    return best;
+}
+
+void add_cases(std::vector<bench_case>& cases, const bench_input& in) {
+    auto per_section = [&](auto kernel) {
+        return [&in, kernel](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                auto r = kernel(in.sections[i % in.sections.size()]);
+                keep(r);
+            }
+        };
+    };
+    if (!in.sections.empty()) {
+        double section_size = static_cast<double>(in.section_bytes) / in.sections.size();
+        auto words = [](std::span<const std::byte> s) {
+            return std::span(reinterpret_cast<const uint32_t*>(s.data()), s.size() / sizeof(uint32_t));
+        };
+        cases.push_back({"block_checksum", &in, section_size, per_section([](auto s) { return block_checksum(s); })});
+        cases.push_back({"block_sum_scalar", &in, section_size, per_section([=](auto s) { return block_sum_scalar(words(s)); })});
+#ifdef BLOCK_CHECKSUM_X86
+        if (__builtin_cpu_supports("sse2")) {
+            cases.push_back({"block_sum_sse2", &in, section_size, per_section([=](auto s) { return block_sum_sse2(words(s)); })});
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            cases.push_back({"block_sum_avx2", &in, section_size, per_section([=](auto s) { return block_sum_avx2(words(s)); })});
+        }
+        if (__builtin_cpu_supports("avx512f")) {
+            cases.push_back({"block_sum_avx512", &in, section_size, per_section([=](auto s) { return block_sum_avx512(words(s)); })});
+        }
+#endif
+        cases.push_back({"crc16", &in, section_size, per_section([](auto s) { return crc16(s); })});
+        cases.push_back({"crc16_update_table", &in, section_size, per_section([](auto s) { return crc16_update_table(0x1121, s); })});
+        cases.push_back({"crc16_update_slice8", &in, section_size, per_section([](auto s) { return crc16_update_slice8(0x1121, s); })});
+#ifdef CRC16_CLMUL
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+            cases.push_back({"crc16_update_clmul", &in, section_size, per_section([](auto s) { return crc16_update_clmul(0x1121, s); })});
+        }
+#endif
+    }
+
+    if (!in.pokemon.empty()) {
+        auto per_pokemon = [&](auto kernel) {
+            return [&in, kernel](size_t ops) {
+                pokemon_box out;
+                for (size_t i = 0; i < ops; i++) {
+                    auto r = kernel(in.pokemon[i % in.pokemon.size()], out);
+                    keep(r);
+                    keep(out);
+                }
+            };
+        };
+        cases.push_back({"pokemon_box::decode", &in, sizeof(pokemon_box), per_pokemon([](const pokemon_box& p, pokemon_box& out) {
+            out = p;
+            out.decode();
+            return 0;
+        })});
+        cases.push_back({"pokemon_box::decode+check", &in, sizeof(pokemon_box), per_pokemon([](const pokemon_box& p, pokemon_box& out) {
+            out = p.decoded();
+            out.check();
+            return 0;
+        })});
+        cases.push_back({"decode_and_check", &in, sizeof(pokemon_box), per_pokemon(decode_and_check)});
+        cases.push_back({"decode_and_check_scalar", &in, sizeof(pokemon_box), per_pokemon(decode_and_check_scalar)});
+#ifdef POKEMON_BOX_KERNELS_X86
+        if (__builtin_cpu_supports("ssse3")) {
+            cases.push_back({"decode_and_check_ssse3", &in, sizeof(pokemon_box), per_pokemon(decode_and_check_ssse3)});
+        }
+#endif
+
+        cases.push_back({"experience_to_level", &in, 0, [&in](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                size_t j = i % in.species.size();
+                auto r = experience_to_level(in.species[j], in.experience[j]);
+                keep(r);
+            }
+        }});
+        cases.push_back({"experience_to_level+next", &in, 0, [&in](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                size_t j = i % in.species.size();
+                level_info r{experience_to_level(in.species[j], in.experience[j]), experience_to_next_level(in.species[j], in.experience[j])};
+                keep(r);
+            }
+        }});
+        //one op is still one pokemon, the batch covers all of them at once and gives both values of
+        //experience_to_level+next
+        cases.push_back({"experience_to_level batch", &in, 0, [&in](size_t ops) {
+            std::vector<level_info> out(in.species.size());
+            for (size_t done = 0; done < ops; done += in.species.size()) {
+                size_t n = std::min(ops - done, in.species.size());
+                experience_to_level(std::span(in.species).first(n), std::span(in.experience).first(n), std::span(out).first(n));
+                keep(out);
+            }
+        }});
+        cases.push_back({"pokemon_string_to_string", &in, 10, [&in](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                auto s = pokemon_string_to_string(in.nicknames[i % in.nicknames.size()]);
+                keep(s);
+            }
+        }});
+        cases.push_back({"pokemon_string_to_utf8", &in, 10, [&in](size_t ops) {
+            std::array<char, 10 * pokemon_char_utf8_max> out;
+            for (size_t i = 0; i < ops; i++) {
+                auto n = pokemon_string_to_utf8(in.nicknames[i % in.nicknames.size()], out);
+                keep(n);
+                keep(out);
+            }
+        }});
+    }
+
+    if (!in.files.empty()) {
+        cases.push_back({"pokemon_gen3_format::check", &in, sizeof(pokemon_gen3_format), [&in](size_t ops) {
+            for (size_t i = 0; i < ops; i++) {
+                //check() only reads, the cast keeps the shared inputs const everywhere else
+                auto& f = const_cast<pokemon_gen3_format&>(in.files[i % in.files.size()]);
+                f.check();
+                keep(f);
+            }
+        }});
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    output_format format = output_format::text;
+    size_t rounds = 5;
+    std::chrono::milliseconds round_time{20};
+    uint64_t seed = 1;
+    std::string filter;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (parse_output_format(args[i], format)) {
+        } else if (args[i] == "--rounds" && i + 1 < args.size()) {
+            rounds = std::max<size_t>(1, std::stoul(args[++i]));
+        } else if (args[i] == "--round-ms" && i + 1 < args.size()) {
+            round_time = std::chrono::milliseconds(std::stoul(args[++i]));
+        } else if (args[i] == "--seed" && i + 1 < args.size()) {
+            seed = std::stoull(args[++i]);
+        } else if (args[i] == "--filter" && i + 1 < args.size()) {
+            filter = args[++i];
+        } else if (args[i] == "--help" || args[i] == "-h") {
+            std::cout << "usage: bench [--format=text|jsonl] [--rounds N] [--round-ms MS] [--seed N] [--filter substring] [save_file_or_directory...]" << std::endl;
+            return 0;
+        } else {
+            paths.push_back(args[i]);
+        }
+    }
+
+    std::vector<bench_input> inputs;
+    inputs.reserve(2);
+    inputs.push_back(synthetic_input(seed, 16, 4096));
+    if (!paths.empty()) {
+        try {
+            inputs.push_back(saves_input(paths));
+        } catch (const std::runtime_error& e) {
+            std::cout << "error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    std::vector<bench_case> cases;
+    for (auto& in: inputs) {
+        add_cases(cases, in);
+    }
+
+    perf_counters counters;
+    output_buffer out;
+    if (format == output_format::text) {
+        out << "benchmark\tinput\tns/op\tMB/s\tcycles/op\tinstructions/op\tcache_misses/op\n";
+    }
+    for (auto& c: cases) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        auto r = run_case(c, round_time, rounds, counters);
+        double bytes_per_s = c.bytes_per_op * 1e9 / r.ns_per_op;
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            record.field("benchmark", c.name).field("input", c.input->name).field("ops", r.ops).field("ns_per_op", r.ns_per_op);
+            if (c.bytes_per_op > 0) {
+                record.field("bytes_per_op", c.bytes_per_op).field("bytes_per_s", bytes_per_s);
+            }
+            for (size_t i = 0; i < perf_counter_names.size(); i++) {
+                if (r.counters.values[i]) {
+                    record.field(std::string(perf_counter_names[i]) + "_per_op", static_cast<double>(*r.counters.values[i]) / r.ops);
+                }
+            }
+        } else {
+            out << c.name << '\t' << c.input->name << '\t' << r.ns_per_op << '\t';
+            if (c.bytes_per_op > 0) {
+                out << bytes_per_s / 1e6;
+            } else {
+                out << '-';
+            }
+            for (auto& v: r.counters.values) {
+                out << '\t';
+                if (v) {
+                    out << static_cast<double>(*v) / r.ops;
+                } else {
+                    out << '-';
+                }
+            }
+            out << '\n';
+        }
+        //results appear as they finish rather than all at the end
+        if (!out.try_flush()) {
+            return 1;
+        }
+    }
+    return 0;
+}
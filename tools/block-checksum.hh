@@ -0,0 +1,114 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOCK_CHECKSUM_X86 1
+#endif
+
+//32-bit wrapping sum of a section, the reference implementation the vector kernels must match
+uint32_t block_sum_scalar(std::span<const uint32_t> data) {
+    return std::accumulate(data.begin(), data.end(), uint32_t{0});
+}
+
+#ifdef BLOCK_CHECKSUM_X86
+__attribute__((target("sse2")))
+uint32_t hsum_epi32(__m128i acc) {
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("sse2")))
+uint32_t block_sum_sse2(std::span<const uint32_t> data) {
+    const uint32_t* p = data.data();
+    size_t n = data.size();
+    size_t i = 0;
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_epi32(acc0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        acc1 = _mm_add_epi32(acc1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 4)));
+    }
+    uint32_t sum = hsum_epi32(_mm_add_epi32(acc0, acc1));
+    return sum + block_sum_scalar(data.subspan(i));
+}
+
+__attribute__((target("avx2")))
+uint32_t block_sum_avx2(std::span<const uint32_t> data) {
+    const uint32_t* p = data.data();
+    size_t n = data.size();
+    size_t i = 0;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+        acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 8)));
+    }
+    __m256i acc256 = _mm256_add_epi32(acc0, acc1);
+    uint32_t sum = hsum_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc256), _mm256_extracti128_si256(acc256, 1)));
+    return sum + block_sum_scalar(data.subspan(i));
+}
+
+__attribute__((target("avx512f")))
+uint32_t block_sum_avx512(std::span<const uint32_t> data) {
+    const uint32_t* p = data.data();
+    size_t n = data.size();
+    size_t i = 0;
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_epi32(acc0, _mm512_loadu_si512(p + i));
+        acc1 = _mm512_add_epi32(acc1, _mm512_loadu_si512(p + i + 16));
+    }
+    //the tail is at most 31 words, finish it with masked loads rather than a scalar loop
+    for (; i < n; i += 16) {
+        __mmask16 mask = n - i >= 16 ? 0xffff : static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc0 = _mm512_add_epi32(acc0, _mm512_maskz_loadu_epi32(mask, p + i));
+    }
+    //spill the lanes instead of using the 512-bit shuffles, which trip -Wuninitialized in gcc 12 headers
+    alignas(64) std::array<uint32_t, 16> lanes;
+    _mm512_store_si512(lanes.data(), _mm512_add_epi32(acc0, acc1));
+    return block_sum_scalar(lanes);
+}
+#endif
+
+using block_sum_fn = uint32_t (*)(std::span<const uint32_t>);
+
+block_sum_fn select_block_sum() {
+#ifdef BLOCK_CHECKSUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return block_sum_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return block_sum_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return block_sum_sse2;
+    }
+#endif
+    return block_sum_scalar;
+}
+
+uint32_t block_sum(std::span<const uint32_t> data) {
+    static const block_sum_fn fn = select_block_sum();
+    return fn(data);
+}
+
+uint16_t block_checksum(std::span<const uint32_t> data) {
+    uint32_t sum = block_sum(data);
+    return sum + (sum >> 16);
+}
+
+uint16_t block_checksum(std::span<const std::byte> data) {
+    return block_checksum(std::span<const uint32_t>(
+        reinterpret_cast<const uint32_t*>(data.data()),
+        data.size() / sizeof(uint32_t)
+    ));
+}
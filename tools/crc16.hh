@@ -0,0 +1,133 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "crc16_ccitt_table.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRC16_CLMUL 1
+#endif
+
+//the update functions work on the raw crc register, crc16() applies the initial value and final inversion
+
+uint16_t crc16_update_table(uint16_t crc, std::span<const std::byte> data) {
+    for (auto x: data) {
+        crc = crc16_ccitt_table_16[(crc ^ static_cast<uint8_t>(x)) % 256] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint16_t crc16_update_slice8(uint16_t crc, std::span<const std::byte> data) {
+    const auto& t = crc16_ccitt_tables;
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + i, sizeof(word));
+        word ^= crc;
+        crc =
+            t[7][(word >>  0) & 0xff] ^ t[6][(word >>  8) & 0xff] ^
+            t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+            t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+            t[1][(word >> 48) & 0xff] ^ t[0][(word >> 56) & 0xff];
+    }
+    return crc16_update_table(crc, data.subspan(i));
+}
+
+#ifdef CRC16_CLMUL
+//gf(2) polynomial helpers for deriving the carry-less multiply constants from the polynomial,
+//polynomials are stored unreflected with bit n as the coefficient of x^n
+constexpr uint64_t crc16_x_pow_mod(unsigned n) {
+    uint32_t r = 1;
+    for (unsigned i = 0; i < n; i++) {
+        r <<= 1;
+        if (r & 0x10000) {
+            r ^= 0x10000 | crc16_ccitt_polynomial;
+        }
+    }
+    return r;
+}
+
+//floor(x^80 / P) without its x^64 term
+constexpr uint64_t crc16_barrett_mu() {
+    unsigned __int128 rem = static_cast<unsigned __int128>(1) << 80;
+    unsigned __int128 p = (static_cast<unsigned __int128>(0x10000 | crc16_ccitt_polynomial));
+    uint64_t quotient = 0;
+    for (int bit = 80; bit >= 16; bit--) {
+        if ((rem >> bit) & 1) {
+            rem ^= p << (bit - 16);
+            if (bit - 16 < 64) {
+                quotient |= uint64_t{1} << (bit - 16);
+            }
+        }
+    }
+    return quotient;
+}
+
+constexpr uint64_t reflect64(uint64_t x) {
+    uint64_t r = 0;
+    for (int i = 0; i < 64; i++) {
+        r |= ((x >> i) & 1) << (63 - i);
+    }
+    return r;
+}
+
+//in the reflected domain a 64-bit lane holds x^63 in bit 0, and a clmul product loses one degree
+//relative to a 128-bit lane, hence the folding constants are x^(k - 1) mod P
+constexpr uint64_t crc16_fold_hi = reflect64(crc16_x_pow_mod(128 + 64 - 1));
+constexpr uint64_t crc16_fold_lo = reflect64(crc16_x_pow_mod(128 - 1));
+constexpr uint64_t crc16_mu = reflect64(crc16_barrett_mu());
+
+__attribute__((target("pclmul,sse4.1")))
+uint16_t crc16_barrett_step(uint64_t m) {
+    //(m * x^16) mod P, m holds the next eight message bytes with the crc already xored in
+    __m128i mu = _mm_cvtsi64_si128(crc16_mu);
+    __m128i q = _mm_clmulepi64_si128(_mm_cvtsi64_si128(m), mu, 0x00);
+    uint64_t quotient = m ^ (static_cast<uint64_t>(_mm_cvtsi128_si64(q)) << 1);
+    __m128i r = _mm_clmulepi64_si128(_mm_cvtsi64_si128(quotient), _mm_cvtsi32_si128(crc16_ccitt_polynomial_reflected), 0x00);
+    uint64_t lo = _mm_cvtsi128_si64(r);
+    uint64_t hi = _mm_extract_epi64(r, 1);
+    return static_cast<uint16_t>((lo >> 63) | (hi << 1));
+}
+
+__attribute__((target("pclmul,sse4.1")))
+uint16_t crc16_update_clmul(uint16_t crc, std::span<const std::byte> data) {
+    if (data.size() < 32) {
+        return crc16_update_slice8(crc, data);
+    }
+    const std::byte* p = data.data();
+    size_t n = data.size();
+    __m128i fold = _mm_set_epi64x(crc16_fold_lo, crc16_fold_hi);
+    __m128i acc = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_cvtsi32_si128(crc));
+    p += 16;
+    n -= 16;
+    for (; n >= 16; p += 16, n -= 16) {
+        __m128i hi = _mm_clmulepi64_si128(acc, fold, 0x00);
+        __m128i lo = _mm_clmulepi64_si128(acc, fold, 0x11);
+        acc = _mm_xor_si128(_mm_xor_si128(hi, lo), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    crc = crc16_barrett_step(_mm_cvtsi128_si64(acc));
+    crc = crc16_barrett_step(_mm_extract_epi64(acc, 1) ^ crc);
+    return crc16_update_slice8(crc, std::span(p, n));
+}
+#endif
+
+using crc16_update_fn = uint16_t (*)(uint16_t, std::span<const std::byte>);
+
+crc16_update_fn select_crc16_update() {
+#ifdef CRC16_CLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        return crc16_update_clmul;
+    }
+#endif
+    return crc16_update_slice8;
+}
+
+uint16_t crc16(std::span<const std::byte> data) {
+    static const crc16_update_fn update = select_crc16_update();
+    return ~update(0x1121, data);
+}
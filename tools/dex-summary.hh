@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include "species-table.hh"
+#include "pokemon-gen3-format.hh"
+#include "pokemon-box-kernels.hh"
+#include "thread-pool.hh"
+#include "stats.hh"
+
+//the species a save has owned, by its pokedex or its party and pc, and the unown forms it has,
+//for one save or any number of them ored together
+struct dex_summary {
+    static constexpr size_t dex_size = gen_id_range(3).second + 1;
+
+    std::bitset<dex_size> dex;
+    std::bitset<28> unowns;
+
+    dex_summary& operator|=(const dex_summary& other) {
+        dex |= other.dex;
+        unowns |= other.unowns;
+        return *this;
+    }
+};
+
+//what a checked save contributes, the species its pokedex has owned and those of every pokemon in its
+//party and pc. visit(location, slot, level, pokemon) sees each of those pokemon, for tools that list
+//them as well, level is the stored one of a party pokemon and 0 for the pc, which doesn't store it
+template<typename F>
+dex_summary summarize_save(pokemon_gen3_format& f, game_save& save, F&& visit) {
+    dex_summary s;
+    auto trainer_info = static_cast<section_trainer_info>(save.get_section_by_id(section_type::trainer_info));
+    for (uint16_t n = gen_id_range(1).first; n <= gen_id_range(3).second; n++) {
+        s.dex[n] = trainer_info.pokedex_owned(n);
+    }
+    auto add = [&](const pokemon_box& pokemon) {
+        s.dex.set(pokemon.national_id());
+        if (auto uf = pokemon.unown_form()) {
+            s.unowns.set(*uf);
+        }
+    };
+    {
+        auto team_items_section = static_cast<section_team_items>(save.get_section_by_id(section_type::team_items));
+        auto party_pokemon = team_items_section.get_pokemon_party(f.game_version(save));
+        STATS_SCOPE(decode);
+        for (size_t i = 0; i < party_pokemon.size(); i++) {
+            auto pokemon = party_pokemon[i].decoded();
+            pokemon.check();
+            add(pokemon);
+            visit(std::string_view("party"), i, pokemon.level, static_cast<const pokemon_box&>(pokemon));
+        }
+    }
+    decode_pc_buffer(pc_buffer_view(save), [&](const pokemon_box& pokemon, size_t i, bool valid) {
+        if (!valid) {
+            pokemon.check();
+        }
+        add(pokemon);
+        visit(std::string_view("box"), i, uint8_t{0}, pokemon);
+    });
+    return s;
+}
+
+dex_summary summarize_save(pokemon_gen3_format& f, game_save& save) {
+    return summarize_save(f, save, [](std::string_view, size_t, uint8_t, const pokemon_box&) {});
+}
+
+//ors the summaries in one contiguous chunk per worker, then the few partial results. a summary
+//is only 56 bytes, so a task per pair or a round per level of a tree would cost more than the ors
+dex_summary reduce_dex_summaries(const std::vector<dex_summary>& summaries, thread_pool& pool) {
+    size_t chunks = std::min(pool.size(), summaries.size());
+    std::vector<dex_summary> partial(chunks);
+    for (size_t c = 0; c < chunks; c++) {
+        pool.submit([&summaries, &partial, c, chunks] {
+            size_t begin = summaries.size() * c / chunks, end = summaries.size() * (c + 1) / chunks;
+            for (size_t i = begin; i < end; i++) {
+                partial[c] |= summaries[i];
+            }
+        });
+    }
+    pool.wait();
+    dex_summary s;
+    for (auto& p: partial) {
+        s |= p;
+    }
+    return s;
+}
+
+//the union of many summaries kept as per-species counts of the saves owning each, so a save's
+//old contribution can be taken out again when it changes or goes away
+struct dex_totals {
+    std::array<uint32_t, dex_summary::dex_size> dex{};
+    std::array<uint32_t, 28> unowns{};
+
+    void add(const dex_summary& s) {
+        for (size_t i = 0; i < dex.size(); i++) {
+            dex[i] += s.dex[i];
+        }
+        for (size_t i = 0; i < unowns.size(); i++) {
+            unowns[i] += s.unowns[i];
+        }
+    }
+
+    void remove(const dex_summary& s) {
+        for (size_t i = 0; i < dex.size(); i++) {
+            dex[i] -= s.dex[i];
+        }
+        for (size_t i = 0; i < unowns.size(); i++) {
+            unowns[i] -= s.unowns[i];
+        }
+    }
+
+    dex_summary summary() const {
+        dex_summary s;
+        for (size_t i = 0; i < dex.size(); i++) {
+            s.dex[i] = dex[i] != 0;
+        }
+        for (size_t i = 0; i < unowns.size(); i++) {
+            s.unowns[i] = unowns[i] != 0;
+        }
+        return s;
+    }
+};
+
+//a summary file is a small header and then one record per save: the file name, the dex as 64 bit
+//words and the unown forms, so runs on different hosts can be merged later
+struct dex_summary_record {
+    static constexpr size_t dex_words = (dex_summary::dex_size + 63) / 64;
+
+    std::string filename;
+    dex_summary summary;
+};
+
+struct dex_summary_file {
+    static constexpr uint32_t magic = 0x53444b50; //"PKDS"
+    static constexpr uint32_t version = 1;
+
+    template<typename T>
+    static void write_pod(std::ostream& out, const T& x) {
+        out.write(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+
+    template<typename T>
+    static void read_pod(std::istream& in, T& x) {
+        in.read(reinterpret_cast<char*>(&x), sizeof(x));
+    }
+
+    static void write(const std::string& path, const std::vector<dex_summary_record>& records) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            write_pod(out, magic);
+            write_pod(out, version);
+            write_pod(out, static_cast<uint32_t>(records.size()));
+            for (auto& r: records) {
+                write_pod(out, static_cast<uint32_t>(r.filename.size()));
+                out.write(r.filename.data(), r.filename.size());
+                std::array<uint64_t, dex_summary_record::dex_words> words{};
+                for (size_t i = 0; i < r.summary.dex.size(); i++) {
+                    words[i / 64] |= uint64_t{r.summary.dex[i]} << (i % 64);
+                }
+                write_pod(out, words);
+                write_pod(out, static_cast<uint32_t>(r.summary.unowns.to_ulong()));
+            }
+            if (!out) {
+                throw std::runtime_error(tmp + ": write failed");
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+    }
+
+    static std::vector<dex_summary_record> read(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+        uint32_t m = 0, v = 0, count = 0;
+        read_pod(in, m);
+        read_pod(in, v);
+        read_pod(in, count);
+        if (!in || m != magic || v != version) {
+            throw std::runtime_error(path + ": not a version " + std::to_string(version) + " dex summary");
+        }
+        std::vector<dex_summary_record> records;
+        for (uint32_t i = 0; i < count; i++) {
+            dex_summary_record r;
+            uint32_t name_size = 0;
+            read_pod(in, name_size);
+            if (!in || name_size > 1 << 16) {
+                throw std::runtime_error(path + ": truncated dex summary");
+            }
+            r.filename.resize(name_size);
+            in.read(r.filename.data(), name_size);
+            std::array<uint64_t, dex_summary_record::dex_words> words{};
+            uint32_t unowns = 0;
+            read_pod(in, words);
+            read_pod(in, unowns);
+            if (!in) {
+                throw std::runtime_error(path + ": truncated dex summary");
+            }
+            for (size_t b = 0; b < r.summary.dex.size(); b++) {
+                r.summary.dex[b] = (words[b / 64] >> (b % 64)) & 1;
+            }
+            r.summary.unowns = unowns;
+            records.push_back(std::move(r));
+        }
+        return records;
+    }
+};
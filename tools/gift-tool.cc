@@ -6,38 +6,92 @@
 #include <numeric>
 #include <vector>
 #include <string>
+#include <optional>
 #include <cassert>
 
 #include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "output.hh"
+#include "stats.hh"
 
 int main(int argc, char* argv[]) {
-    std::vector<std::string> args(argv + 1, argv + argc);
+    std::vector<std::string> args;
+    output_format format = output_format::text;
+    for (int i = 1; i < argc; i++) {
+        if (!parse_output_format(argv[i], format) && !parse_stats_option(argv[i])) {
+            args.push_back(argv[i]);
+        }
+    }
+    output_buffer out;
     if (args.size() != 2) {
-        std::cout << "usage: gift-tool save-file mystery-gift-file" << std::endl;
+        out << "usage: gift-tool [--format=text|jsonl] [--stats] save-file mystery-gift-file\n";
         return 0;
     }
+    //in jsonl mode every step is one record with the file it concerns
+    auto report = [&](std::string_view step, const std::string& filename, std::string_view text, const std::string& error) {
+        STATS_SCOPE(output);
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            record.field("step", step);
+            if (!filename.empty()) {
+                record.field("file", filename).field("good", error.empty());
+            }
+            if (!error.empty()) {
+                record.field("error", error);
+            }
+        } else if (!error.empty()) {
+            out << "error in " << filename << ": " << error << '\n';
+        } else {
+            out << text << '\n';
+        }
+        out.try_flush();
+    };
     std::string filename0 = args[0];
-    auto m0 = mmap_file(filename0);
-    auto d0 = m0.data;
+    std::optional<mmap_file> m0;
+    //an rtc footer or padding after the flash is left as it is
+    std::span<std::byte> d0;
+    try {
+        m0.emplace(filename0);
+        d0 = save_payload(m0->data);
+    } catch (const std::runtime_error& e) {
+        report("save", filename0, "", e.what());
+        return 1;
+    }
     auto& f0 = *reinterpret_cast<pokemon_gen3_format*>(d0.data());
     try {
-        f0.check();
-        std::cout << "good pokemon " << f0.game_version() << " save file: " << filename0 << std::endl;
+        auto& latest = f0.check();
+        report("save", filename0, "good pokemon " + game_version_string(f0.game_version(latest)) + " save file: " + filename0, "");
     } catch (const std::runtime_error& e) {
-        std::cout << "error in " << filename0 << ": " << e.what() << std::endl;
+        report("save", filename0, "", e.what());
+        return 1;
     }
     std::string filename1 = args[1];
-    auto m1 = mmap_file(filename1);
-    auto d1 = m1.data;
-    auto& f1 = *reinterpret_cast<mystery_gift_file_format*>(d1.data());
+    std::optional<mmap_file> m1;
     try {
+        m1.emplace(filename1, mmap_mode::read_only);
+        if (m1->data.size() < sizeof(mystery_gift_file_format)) {
+            throw std::runtime_error("wrong mystery gift file size");
+        }
+        auto& f1 = *reinterpret_cast<mystery_gift_file_format*>(m1->data.data());
         f1.check();
-        std::cout << "good mystery gift file: " << filename1 << std::endl;
+        report("gift", filename1, "good mystery gift file: " + filename1, "");
+    } catch (const std::runtime_error& e) {
+        report("gift", filename1, "", e.what());
+        return 1;
+    }
+    auto& f1 = *reinterpret_cast<mystery_gift_file_format*>(m1->data.data());
+    report("write", "", "writing mystery gift to save", "");
+    //the gift goes into a new save in the other slot, so the current one survives a crash
+    try {
+        slot_writer writer(f0, d0, m0->fd);
+        auto& save = writer.begin();
+        f0.write_mystery_gift(save, f1, writer.session);
+        writer.commit();
     } catch (const std::runtime_error& e) {
-        std::cout << "error in " << filename1 << ": " << e.what() << std::endl;
+        report("write", filename0, "", e.what());
+        return 1;
     }
-    std::cout << "writing mystery gift to save" << std::endl;
-    f0.write_mystery_gift(f1);
-    std::cout << "done" << std::endl;
-    return 0;
+    report("done", "", "done", "");
+    stats_report(format);
+    return out.try_flush() ? 0 : 1;
 }
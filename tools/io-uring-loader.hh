@@ -0,0 +1,367 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <span>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+struct loaded_file {
+    size_t index;
+    std::span<std::byte> data;
+    std::string error;
+    //the file filled the whole buffer and may go on past it, data is only its start
+    bool truncated = false;
+    //fstat of the descriptor the data was read through, with stat_files set
+    struct stat stat{};
+};
+
+//loads many small files through io_uring: each batch submits every openat at once, then every
+//read into a pool of fixed buffers, then every close, so a batch costs three io_uring_enter calls
+//instead of four or five syscalls per file. the buffers are two halves used in turn, so the next
+//batch is read while the caller still checks the last one. falls back to open + pread when
+//io_uring is missing (old kernels, seccomp) or doesn't support those opcodes
+struct io_uring_loader {
+    //a little over a save, which holds a save with an emulator rtc footer. a larger file (a padded
+    //save, or one that is wrong) comes back truncated for the caller to read another way
+    static constexpr size_t buffer_size = 128 * 1024 + 4096;
+
+    unsigned depth;
+    std::vector<std::byte> buffers;
+    //fstat every file before it is closed, for callers that remember results by file identity
+    bool stat_files = false;
+
+    int ring_fd = -1;
+    void* sq_ring = MAP_FAILED;
+    void* cq_ring = MAP_FAILED;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    explicit io_uring_loader(unsigned depth_ = 64):
+        depth(depth_),
+        buffers(2 * static_cast<size_t>(depth_) * buffer_size)
+    {
+        if (!setup()) {
+            teardown();
+        }
+    }
+
+    ~io_uring_loader() {
+        teardown();
+    }
+
+    io_uring_loader(const io_uring_loader&) = delete;
+    io_uring_loader& operator=(const io_uring_loader&) = delete;
+
+    bool available() const {
+        return ring_fd >= 0;
+    }
+
+    bool setup() {
+        io_uring_params p{};
+        ring_fd = syscall(__NR_io_uring_setup, depth, &p);
+        if (ring_fd < 0) {
+            return false;
+        }
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            return false;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring = sq_ring;
+        } else {
+            cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) {
+                return false;
+            }
+        }
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(s);
+        auto* sq = static_cast<std::byte*>(sq_ring);
+        auto* cq = static_cast<std::byte*>(cq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        depth = std::min(depth, p.sq_entries);
+        return supports({IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE});
+    }
+
+    bool supports(std::initializer_list<uint8_t> ops) {
+        constexpr size_t num_ops = 256;
+        std::vector<std::byte> probe_buffer(sizeof(io_uring_probe) + num_ops * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, num_ops) < 0) {
+            return false;
+        }
+        for (auto op: ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void teardown() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        cq_ring = MAP_FAILED;
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+            sq_ring = MAP_FAILED;
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+            ring_fd = -1;
+        }
+    }
+
+    io_uring_sqe& next_sqe() {
+        unsigned tail = *sq_tail;
+        unsigned i = tail & *sq_mask;
+        io_uring_sqe& sqe = sqes[i];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sq_array[i] = i;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    //sqes left unsubmitted by the last failed submit_and_reap, the newest ones queued
+    unsigned dropped = 0;
+
+    //submits everything queued and calls f(user_data, res) for each of the n completions. on an
+    //error it takes back the sqes the kernel never saw, counts them in dropped and throws
+    template<typename F>
+    void submit_and_reap(unsigned n, F&& f) {
+        unsigned reaped = 0;
+        unsigned to_submit = n;
+        while (reaped < n) {
+            int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                int e = errno;
+                __atomic_store_n(sq_tail, *sq_tail - to_submit, __ATOMIC_RELEASE);
+                dropped = to_submit;
+                throw std::runtime_error(std::string("io_uring_enter: ") + strerror(e));
+            }
+            //EAGAIN and EBUSY mean the completions have to be reaped before more can be submitted
+            if (ret > 0) {
+                to_submit -= std::min<unsigned>(to_submit, ret);
+            }
+            unsigned head = *cq_head;
+            while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                f(cqe.user_data, cqe.res);
+                head++;
+                reaped++;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    std::span<std::byte> buffer(size_t slot) {
+        return std::span(buffers).subspan(slot * buffer_size, buffer_size);
+    }
+
+    //first is the buffer of the batch's slot 0, depth apart for the two halves
+    void load_batch_io_uring(const std::vector<std::string>& filenames, std::span<loaded_file> batch, size_t first) {
+        std::vector<int> fds(batch.size(), -1);
+        //slots whose close went to the kernel, their fd is no longer ours to close
+        std::vector<bool> closing(batch.size(), false);
+        try {
+            for (size_t slot = 0; slot < batch.size(); slot++) {
+                auto& sqe = next_sqe();
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(filenames[batch[slot].index].c_str());
+                sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                sqe.user_data = slot;
+            }
+            submit_and_reap(batch.size(), [&](uint64_t slot, int res) {
+                if (res < 0) {
+                    batch[slot].error = filenames[batch[slot].index] + ": " + strerror(-res);
+                } else {
+                    fds[slot] = res;
+                }
+            });
+
+            //a read can come back short, those are read on from where they stopped until the end of
+            //the file or of the buffer
+            std::vector<size_t> filled(batch.size(), 0);
+            std::vector<size_t> reading;
+            for (size_t slot = 0; slot < batch.size(); slot++) {
+                if (fds[slot] >= 0) {
+                    reading.push_back(slot);
+                }
+            }
+            while (!reading.empty()) {
+                for (auto slot: reading) {
+                    auto& sqe = next_sqe();
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = fds[slot];
+                    sqe.addr = reinterpret_cast<uint64_t>(buffer(first + slot).data() + filled[slot]);
+                    sqe.len = buffer_size - filled[slot];
+                    sqe.off = filled[slot];
+                    sqe.user_data = slot;
+                }
+                std::vector<size_t> more;
+                submit_and_reap(reading.size(), [&](uint64_t slot, int res) {
+                    if (res < 0) {
+                        batch[slot].error = filenames[batch[slot].index] + ": " + strerror(-res);
+                        return;
+                    }
+                    filled[slot] += res;
+                    if (res == 0 || filled[slot] == buffer_size) {
+                        batch[slot].data = buffer(first + slot).first(filled[slot]);
+                        batch[slot].truncated = filled[slot] == buffer_size;
+                    } else {
+                        more.push_back(slot);
+                    }
+                });
+                reading = std::move(more);
+            }
+
+            unsigned closes = 0;
+            for (size_t slot = 0; slot < batch.size(); slot++) {
+                if (fds[slot] < 0) {
+                    continue;
+                }
+                if (stat_files && batch[slot].error.empty() && fstat(fds[slot], &batch[slot].stat) < 0) {
+                    batch[slot].error = filenames[batch[slot].index] + ": " + strerror(errno);
+                }
+                auto& sqe = next_sqe();
+                sqe.opcode = IORING_OP_CLOSE;
+                sqe.fd = fds[slot];
+                sqe.user_data = slot;
+                closing[slot] = true;
+                closes++;
+            }
+            submit_and_reap(closes, [](uint64_t, int){});
+        } catch (const std::runtime_error&) {
+            //the closes taken back from the ring are the last ones queued
+            for (size_t slot = batch.size(); slot-- > 0 && dropped > 0;) {
+                if (closing[slot]) {
+                    closing[slot] = false;
+                    dropped--;
+                }
+            }
+            for (size_t slot = 0; slot < batch.size(); slot++) {
+                if (fds[slot] >= 0 && !closing[slot]) {
+                    close(fds[slot]);
+                }
+            }
+            throw;
+        }
+    }
+
+    void load_batch_pread(const std::vector<std::string>& filenames, std::span<loaded_file> batch, size_t first) {
+        for (size_t slot = 0; slot < batch.size(); slot++) {
+            const auto& filename = filenames[batch[slot].index];
+            int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                batch[slot].error = filename + ": " + strerror(errno);
+                continue;
+            }
+            size_t filled = 0;
+            while (filled < buffer_size) {
+                ssize_t n = pread(fd, buffer(first + slot).data() + filled, buffer_size - filled, filled);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    batch[slot].error = filename + ": " + strerror(errno);
+                    break;
+                }
+                if (n == 0) {
+                    break;
+                }
+                filled += n;
+            }
+            if (stat_files && batch[slot].error.empty() && fstat(fd, &batch[slot].stat) < 0) {
+                batch[slot].error = filename + ": " + strerror(errno);
+            }
+            if (batch[slot].error.empty()) {
+                batch[slot].data = buffer(first + slot).first(filled);
+                batch[slot].truncated = filled == buffer_size;
+            }
+            close(fd);
+        }
+    }
+
+    void load_batch(const std::vector<std::string>& filenames, size_t start, std::vector<loaded_file>& batch, size_t first) {
+        size_t n = std::min<size_t>(depth, filenames.size() - start);
+        batch.assign(n, loaded_file{});
+        for (size_t slot = 0; slot < n; slot++) {
+            batch[slot].index = start + slot;
+        }
+        if (available()) {
+            try {
+                load_batch_io_uring(filenames, batch, first);
+            } catch (const std::runtime_error&) {
+                //the ring is given up on and this and every later batch read without it
+                teardown();
+                batch.assign(n, loaded_file{});
+                for (size_t slot = 0; slot < n; slot++) {
+                    batch[slot].index = start + slot;
+                }
+            }
+        }
+        if (!available()) {
+            load_batch_pread(filenames, batch, first);
+        }
+    }
+
+    //calls on_batch(std::span<loaded_file>) for every batch of up to depth files. on_batch may hand
+    //the files to other threads and return at once: the next batch is loaded into the other half of
+    //the buffers meanwhile, then drain() has to wait for all the work on the last one before
+    //on_batch gets the next, whose buffers it frees for the batch after. drain() is called once more
+    //at the end
+    template<typename F, typename G>
+    void load(const std::vector<std::string>& filenames, F&& on_batch, G&& drain) {
+        std::array<std::vector<loaded_file>, 2> batches;
+        for (size_t start = 0, half = 0; start < filenames.size(); start += depth, half ^= 1) {
+            load_batch(filenames, start, batches[half], half * depth);
+            drain();
+            on_batch(std::span(batches[half]));
+        }
+        drain();
+    }
+};
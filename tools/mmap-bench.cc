@@ -0,0 +1,99 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <string>
+
+#include "block-checksum.hh"
+
+//drops the page cache for the file, this only works for clean pages but needs no privileges
+void evict(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(filename + ": " + strerror(errno));
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+//touches every byte the way a full check() would
+uint32_t consume(std::span<const std::byte> data) {
+    return block_sum(std::span(reinterpret_cast<const uint32_t*>(data.data()), data.size() / sizeof(uint32_t)));
+}
+
+struct load_mode {
+    std::string name;
+    std::function<uint32_t(const std::string&)> load;
+};
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (args.empty()) {
+        std::cout << "usage: mmap-bench [--warm] [--rounds N] file..." << std::endl;
+        return 0;
+    }
+    bool cold = true;
+    size_t rounds = 5;
+    std::vector<std::string> files;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--warm") {
+            cold = false;
+        } else if (args[i] == "--rounds" && i + 1 < args.size()) {
+            rounds = std::stoul(args[++i]);
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    pread_file_reader reader;
+    auto mmap_with = [](mmap_mode mode, mmap_hints hints) {
+        return [=](const std::string& filename) {
+            auto m = mmap_file(filename, mode, hints);
+            return consume(m.data);
+        };
+    };
+    std::vector<load_mode> modes = {
+        {"mmap shared", mmap_with(mmap_mode::shared, {})},
+        {"mmap private", mmap_with(mmap_mode::private_copy, {})},
+        {"mmap read-only", mmap_with(mmap_mode::read_only, {})},
+        {"mmap read-only populate", mmap_with(mmap_mode::read_only, {.populate = true})},
+        {"mmap read-only willneed", mmap_with(mmap_mode::read_only, {.willneed = true})},
+        {"mmap read-only sequential", mmap_with(mmap_mode::read_only, {.sequential = true})},
+        {"pread reused buffer", [&](const std::string& filename) { return consume(reader.read(filename)); }},
+    };
+
+    size_t total_bytes = 0;
+    for (auto& filename: files) {
+        total_bytes += mmap_file(filename, mmap_mode::read_only).data.size();
+    }
+
+    std::cout << (cold ? "cold" : "warm") << " page cache, " << files.size() << " files, " << rounds << " rounds" << std::endl;
+    std::cout << std::left << std::setw(28) << "mode" << std::right << std::setw(14) << "us/file" << std::setw(14) << "MB/s" << std::endl;
+    uint32_t sink = 0;
+    for (auto& mode: modes) {
+        std::chrono::nanoseconds elapsed{0};
+        for (size_t round = 0; round < rounds; round++) {
+            if (cold) {
+                for (auto& filename: files) {
+                    evict(filename);
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (auto& filename: files) {
+                sink += mode.load(filename);
+            }
+            elapsed += std::chrono::steady_clock::now() - start;
+        }
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        double per_file_us = seconds * 1e6 / (rounds * files.size());
+        double mb_per_s = rounds * total_bytes / seconds / 1e6;
+        std::cout << std::left << std::setw(28) << mode.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << per_file_us << std::setw(14) << mb_per_s << std::endl;
+    }
+    //keeps the loads from being optimised away
+    return sink == 0x12345678 ? 1 : 0;
+}
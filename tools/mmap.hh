@@ -1,38 +1,81 @@
+#pragma once
+
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <unistd.h> 
+#include <unistd.h>
 
 #include <span>
 #include <string>
+#include <vector>
 #include <cstring>
 #include <cstddef>
 #include <stdexcept>
 
+#include "stats.hh"
+
+enum class mmap_mode {
+    //writes go to the file
+    shared,
+    //writes stay in this process, pages are copied on the first write
+    private_copy,
+    //PROT_READ only, works on read-only files and never dirties a page
+    read_only,
+};
+
+struct mmap_hints {
+    //prefault the whole file with MAP_POPULATE
+    bool populate = false;
+    //madvise(MADV_WILLNEED) to start readahead of the whole file straight away
+    bool willneed = false;
+    //madvise(MADV_SEQUENTIAL) for aggressive readahead and early reclaim
+    bool sequential = false;
+};
+
 struct mmap_file {
     std::span<std::byte> data;
     std::string filename;
     int fd;
     mmap_file(std::string filename_, bool writable = true):
+        mmap_file(filename_, writable ? mmap_mode::shared : mmap_mode::private_copy)
+    {}
+
+    mmap_file(std::string filename_, mmap_mode mode, mmap_hints hints = {}):
         filename(filename_)
     {
-        fd = open(filename.c_str(), O_RDWR);
+        STATS_SCOPE(mmap);
+        fd = open(filename.c_str(), mode == mmap_mode::shared ? O_RDWR : O_RDONLY);
         if (fd < 0) {
             throw std::runtime_error(filename + ": " + strerror(errno));
         }
         struct stat st;
         int err = fstat(fd, &st);
         if (err < 0) {
+            close(fd);
             throw std::runtime_error(filename + ": " + strerror(errno));
         }
         size_t len = st.st_size;
-        void* addr = mmap(NULL, len, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        int prot = mode == mmap_mode::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+        int flags = mode == mmap_mode::shared ? MAP_SHARED : MAP_PRIVATE;
+        if (hints.populate) {
+            flags |= MAP_POPULATE;
+        }
+        void* addr = mmap(NULL, len, prot, flags, fd, 0);
         if (addr == MAP_FAILED) {
+            close(fd);
             throw std::runtime_error(filename + ": " + strerror(errno));
         }
+        if (hints.willneed) {
+            madvise(addr, len, MADV_WILLNEED);
+        }
+        if (hints.sequential) {
+            madvise(addr, len, MADV_SEQUENTIAL);
+        }
 
         data = {static_cast<std::byte*>(addr), len};
+        STATS_ADD(files, 1);
+        STATS_ADD(bytes, len);
     }
 
     ~mmap_file() noexcept(false) {
@@ -41,8 +84,45 @@ struct mmap_file {
             throw std::runtime_error(filename + ": " + strerror(errno));
         }
         err = close(fd);
+        if (err < 0) {
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+    }
+};
+
+//reads whole files with pread into one buffer that is reused from file to file, for small files
+//this is a single syscall instead of mmap, page faults and munmap
+struct pread_file_reader {
+    std::vector<std::byte> buffer;
+
+    std::span<std::byte> read(const std::string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
         if (fd < 0) {
             throw std::runtime_error(filename + ": " + strerror(errno));
         }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+        size_t len = st.st_size;
+        if (buffer.size() < len) {
+            buffer.resize(len);
+        }
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = pread(fd, buffer.data() + done, len - done, done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                int e = n < 0 ? errno : EIO;
+                close(fd);
+                throw std::runtime_error(filename + ": " + strerror(e));
+            }
+            done += n;
+        }
+        close(fd);
+        return std::span(buffer).first(len);
     }
 };
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+enum class output_format {
+    text,
+    jsonl,
+};
+
+//--format=text or --format=jsonl, returns false for any other argument
+bool parse_output_format(std::string_view arg, output_format& format) {
+    if (arg == "--format=text") {
+        format = output_format::text;
+    } else if (arg == "--format=jsonl") {
+        format = output_format::jsonl;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//a large reusable buffer in front of a file descriptor instead of std::cout and std::endl: numbers
+//are formatted with std::to_chars and nothing is written until the buffer fills up or flush() is
+//called. with fd -1 it only collects, so a worker can build its output for the caller to take.
+//tools flush at the end themselves so a failed write shows in the exit status, the destructor
+//only writes what is left on an early return
+struct output_buffer {
+    static constexpr size_t default_capacity = 1 << 16;
+
+    std::string data;
+    int fd;
+    size_t capacity;
+    //set by the first write that fails, everything after it is dropped and every flush() throws it
+    //again, so the tool's final flush reports it however much was written in between
+    std::string error;
+
+    explicit output_buffer(int fd_ = STDOUT_FILENO, size_t capacity_ = default_capacity):
+        fd(fd_),
+        capacity(capacity_)
+    {
+        data.reserve(capacity);
+    }
+
+    ~output_buffer() {
+        try_flush();
+    }
+
+    output_buffer(const output_buffer&) = delete;
+    output_buffer& operator=(const output_buffer&) = delete;
+
+    void flush() {
+        if (fd < 0) {
+            return;
+        }
+        size_t done = 0;
+        while (error.empty() && done < data.size()) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                error = std::string("write: ") + strerror(errno);
+                break;
+            }
+            done += n;
+        }
+        data.clear();
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    //flush() where a failed write can't be reported any more, e.g. the end of a tool's output, false
+    //if this or any earlier write failed
+    bool try_flush() noexcept {
+        try {
+            flush();
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        return true;
+    }
+
+    //hands over everything collected so far
+    std::string take() {
+        std::string s = std::move(data);
+        data.clear();
+        return s;
+    }
+
+    void maybe_flush() {
+        if (data.size() >= capacity) {
+            try_flush();
+        }
+    }
+
+    output_buffer& operator<<(std::string_view s) {
+        data.append(s);
+        maybe_flush();
+        return *this;
+    }
+
+    output_buffer& operator<<(const char* s) {
+        return *this << std::string_view(s);
+    }
+
+    output_buffer& operator<<(const std::string& s) {
+        return *this << std::string_view(s);
+    }
+
+    output_buffer& operator<<(char c) {
+        data.push_back(c);
+        maybe_flush();
+        return *this;
+    }
+
+    output_buffer& operator<<(std::integral auto x) {
+        std::array<char, 24> chars;
+        auto [end, ec] = std::to_chars(chars.begin(), chars.end(), x);
+        return *this << std::string_view(chars.begin(), end);
+    }
+
+    //six significant digits like the iostream default
+    output_buffer& operator<<(std::floating_point auto x) {
+        std::array<char, 32> chars;
+        auto [end, ec] = std::to_chars(chars.begin(), chars.end(), static_cast<double>(x), std::chars_format::general, 6);
+        return *this << std::string_view(chars.begin(), end);
+    }
+};
+
+//writes one json object as one line: the record opens on construction, every field call adds a
+//key and value and the destructor closes the line, which is left for the next write to flush
+struct json_record {
+    output_buffer& out;
+    bool first = true;
+
+    explicit json_record(output_buffer& out_): out(out_) {
+        out << '{';
+    }
+
+    ~json_record() {
+        out.data.append("}\n");
+    }
+
+    json_record(const json_record&) = delete;
+    json_record& operator=(const json_record&) = delete;
+
+    static void escaped(output_buffer& out, std::string_view s) {
+        out << '"';
+        size_t start = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            unsigned char c = s[i];
+            if (c != '"' && c != '\\' && c >= 0x20) {
+                continue;
+            }
+            out << s.substr(start, i - start);
+            if (c == '"' || c == '\\') {
+                out << '\\' << static_cast<char>(c);
+            } else {
+                constexpr std::string_view hex = "0123456789abcdef";
+                out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+            }
+            start = i + 1;
+        }
+        out << s.substr(start) << '"';
+    }
+
+    json_record& key(std::string_view k) {
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        escaped(out, k);
+        out << ':';
+        return *this;
+    }
+
+    json_record& field(std::string_view k, std::string_view v) {
+        key(k);
+        escaped(out, v);
+        return *this;
+    }
+
+    json_record& field(std::string_view k, const char* v) {
+        return field(k, std::string_view(v));
+    }
+
+    json_record& field(std::string_view k, const std::string& v) {
+        return field(k, std::string_view(v));
+    }
+
+    json_record& field(std::string_view k, bool v) {
+        key(k);
+        out << (v ? "true" : "false");
+        return *this;
+    }
+
+    json_record& field(std::string_view k, std::integral auto v) {
+        key(k);
+        out << v;
+        return *this;
+    }
+
+    json_record& field(std::string_view k, std::floating_point auto v) {
+        key(k);
+        out << v;
+        return *this;
+    }
+
+    //an array of strings, e.g. the missing species
+    template<typename R>
+    json_record& strings(std::string_view k, const R& values) {
+        key(k);
+        out << '[';
+        bool first_value = true;
+        for (auto& v: values) {
+            if (!first_value) {
+                out << ',';
+            }
+            first_value = false;
+            escaped(out, v);
+        }
+        out << ']';
+        return *this;
+    }
+};
+
+//the "error in file: what" line every tool prints, or its record
+void report_error(output_buffer& out, output_format format, std::string_view filename, std::string_view error) {
+    if (format == output_format::jsonl) {
+        json_record(out).field("file", filename).field("error", error);
+    } else {
+        out << "error in " << filename << ": " << error << '\n';
+    }
+}
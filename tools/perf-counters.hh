@@ -0,0 +1,126 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include <cstdint>
+
+enum class perf_counter {
+    cycles,
+    instructions,
+    cache_misses,
+};
+
+constexpr std::array<std::string_view, 3> perf_counter_names = {
+    "cycles",
+    "instructions",
+    "cache_misses",
+};
+
+struct perf_sample {
+    std::array<std::optional<uint64_t>, 3> values;
+
+    std::optional<uint64_t> operator[](perf_counter c) const {
+        return values[static_cast<size_t>(c)];
+    }
+
+    perf_sample& operator+=(const perf_sample& other) {
+        for (size_t i = 0; i < values.size(); i++) {
+            if (other.values[i]) {
+                values[i] = values[i].value_or(0) + *other.values[i];
+            }
+        }
+        return *this;
+    }
+
+    //the counts between an earlier sample and this one
+    perf_sample operator-(const perf_sample& earlier) const {
+        perf_sample d;
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i] && earlier.values[i]) {
+                d.values[i] = *values[i] - *earlier.values[i];
+            }
+        }
+        return d;
+    }
+};
+
+//user space hardware counters of the calling thread. perf_event_open is missing in many
+//containers and vms or refused by perf_event_paranoid, every counter that fails to open simply
+//reads as empty so callers only report what the machine has
+struct perf_counters {
+    std::array<int, 3> fds = {-1, -1, -1};
+
+    perf_counters() {
+        constexpr std::array<uint64_t, 3> configs = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+        };
+        for (size_t i = 0; i < fds.size(); i++) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+    }
+
+    ~perf_counters() {
+        for (int fd: fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    bool available() const {
+        for (int fd: fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+        for (int fd: fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    //the running totals, for counters left enabled and read at both ends of what is measured
+    perf_sample read() const {
+        perf_sample s;
+        for (size_t i = 0; i < fds.size(); i++) {
+            uint64_t value = 0;
+            if (fds[i] >= 0 && ::read(fds[i], &value, sizeof(value)) == sizeof(value)) {
+                s.values[i] = value;
+            }
+        }
+        return s;
+    }
+
+    perf_sample stop() {
+        for (int fd: fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        return read();
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+#include "pokemon-gen3-format.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POKEMON_BOX_KERNELS_X86 1
+#endif
+
+//writes the decrypted form of encrypted into out and returns whether its checksum matches,
+//i.e. decoded() + check() in one pass over the 48 data bytes, out may alias encrypted
+bool decode_and_check_scalar(const pokemon_box& encrypted, pokemon_box& out) {
+    out = encrypted.decoded();
+    auto words = span_cast<uint16_t>(out.data);
+    uint16_t sum = std::accumulate(words.begin(), words.end(), uint16_t{0});
+    return sum == out.checksum;
+}
+
+#ifdef POKEMON_BOX_KERNELS_X86
+//for each of the 24 orders, the pshufb masks that gather output register j from input register k,
+//bytes belonging to another input register are 0x80 so the three shuffles can simply be ored
+using pokemon_data_shuffle = std::array<std::array<std::array<uint8_t, 16>, 3>, 3>;
+
+constexpr std::array<pokemon_data_shuffle, 24> make_pokemon_data_shuffles() {
+    std::array<pokemon_data_shuffle, 24> shuffles{};
+    for (size_t order = 0; order < shuffles.size(); order++) {
+        for (size_t dst = 0; dst < 48; dst++) {
+            size_t src = pokemon_data_positions[order][dst / 12] * 12 + dst % 12;
+            for (size_t k = 0; k < 3; k++) {
+                shuffles[order][dst / 16][k][dst % 16] = (src / 16 == k) ? src % 16 : 0x80;
+            }
+        }
+    }
+    return shuffles;
+}
+
+alignas(16) constexpr std::array<pokemon_data_shuffle, 24> pokemon_data_shuffles = make_pokemon_data_shuffles();
+
+__attribute__((target("ssse3")))
+bool decode_and_check_ssse3(const pokemon_box& encrypted, pokemon_box& out) {
+    STATS_ADD(pokemon_decoded, 1);
+    const auto* bytes = reinterpret_cast<const std::byte*>(&encrypted.data);
+    const auto& shuffle = pokemon_data_shuffles[encrypted.personality % 24];
+    //the key repeats every 4 bytes and the substructures are 12 bytes, so xor before shuffling
+    const __m128i key = _mm_set1_epi32(encrypted.original_trainer_id ^ encrypted.personality);
+    __m128i in[3];
+    for (size_t k = 0; k < 3; k++) {
+        in[k] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 16 * k)), key);
+    }
+    //the checksum is a sum of halfwords, so it doesn't care about the order either
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(in[0], ones), _mm_madd_epi16(in[1], ones)), _mm_madd_epi16(in[2], ones));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    //everything is in registers by now, so out may alias encrypted. memmove, as memcpy of a
+    //range onto itself is undefined
+    std::memmove(&out, &encrypted, offsetof(pokemon_box, data));
+    auto* out_bytes = reinterpret_cast<std::byte*>(&out.data);
+    for (size_t j = 0; j < 3; j++) {
+        __m128i gathered = _mm_setzero_si128();
+        for (size_t k = 0; k < 3; k++) {
+            __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle[j][k].data()));
+            gathered = _mm_or_si128(gathered, _mm_shuffle_epi8(in[k], mask));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_bytes + 16 * j), gathered);
+    }
+    return static_cast<uint16_t>(_mm_cvtsi128_si32(sum)) == out.checksum;
+}
+#endif
+
+using pc_buffer_bitmap = std::bitset<pc_buffer_view::size>;
+using decode_and_check_fn = bool (*)(const pokemon_box&, pokemon_box&);
+
+decode_and_check_fn select_decode_and_check() {
+#ifdef POKEMON_BOX_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        return decode_and_check_ssse3;
+    }
+#endif
+    return decode_and_check_scalar;
+}
+
+bool decode_and_check(const pokemon_box& encrypted, pokemon_box& out) {
+    static const decode_and_check_fn fn = select_decode_and_check();
+    return fn(encrypted, out);
+}
+
+//decodes every non-empty entry of the pc buffer without touching the buffer itself, calling
+//f(const pokemon_box& decoded, size_t index, bool valid) for each, and returns the valid bitmap
+template<typename F>
+pc_buffer_bitmap decode_pc_buffer(const pc_buffer_view& view, F&& f) {
+    STATS_SCOPE(decode);
+    static const decode_and_check_fn fn = select_decode_and_check();
+    pc_buffer_bitmap valid;
+    view.for_each([&](const pokemon_box& encrypted, size_t i) {
+        if (encrypted.empty()) {
+            return;
+        }
+        pokemon_box decoded;
+        valid[i] = fn(encrypted, decoded);
+        f(static_cast<const pokemon_box&>(decoded), i, static_cast<bool>(valid[i]));
+    });
+    return valid;
+}
+
+pc_buffer_bitmap decode_pc_buffer(const pc_buffer_view& view) {
+    return decode_pc_buffer(view, [](const pokemon_box&, size_t, bool){});
+}
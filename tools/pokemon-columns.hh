@@ -0,0 +1,259 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "mmap.hh"
+#include "pokemon-gen3-format.hh"
+
+//where a row came from
+enum class pokemon_location: uint8_t {
+    party,
+    box,
+};
+
+//on disk an export is this header, a directory of columns, the source file names and then every
+//column as one contiguous array starting on a 64 byte boundary, so a read-only mapping of the file
+//can be scanned in place one column at a time
+struct pokemon_columns_header {
+    static constexpr uint32_t magic_value = 0x4c434b50; //"PKCL"
+    static constexpr uint32_t version_value = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t rows;
+    uint32_t num_columns;
+    uint32_t num_files;
+    //the file names, each terminated by a nul
+    uint64_t file_names_offset;
+    uint64_t file_names_size;
+};
+
+struct pokemon_column_entry {
+    std::array<char, 24> name;
+    //bytes per row
+    uint32_t element_size;
+    uint32_t _;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static_assert(sizeof(pokemon_columns_header) == 40);
+static_assert(sizeof(pokemon_column_entry) == 48);
+
+constexpr size_t pokemon_column_alignment = 64;
+
+//one vector per field, rows are appended one pokemon at a time and whole exports can be appended
+//to each other
+struct pokemon_columns {
+    std::vector<std::string> files;
+
+    std::vector<uint32_t> file;
+    //0 for save slot a, 1 for b
+    std::vector<uint8_t> save_slot;
+    std::vector<pokemon_location> location;
+    //0xff in the party
+    std::vector<uint8_t> box;
+    std::vector<uint8_t> slot;
+    //whether the substructure checksum matched
+    std::vector<uint8_t> valid;
+    std::vector<uint16_t> species;
+    std::vector<uint32_t> personality;
+    std::vector<uint32_t> original_trainer_id;
+    std::vector<uint32_t> experience;
+    std::vector<uint8_t> level;
+    std::vector<std::array<uint8_t, 6>> ivs;
+    std::vector<std::array<uint8_t, 6>> evs;
+    std::vector<std::array<uint16_t, 4>> moves;
+
+    //calls f(name, vector&) for every column, in file order
+    template<typename F>
+    void for_each_column(F&& f) {
+        f("file", file);
+        f("save_slot", save_slot);
+        f("location", location);
+        f("box", box);
+        f("slot", slot);
+        f("valid", valid);
+        f("species", species);
+        f("personality", personality);
+        f("original_trainer_id", original_trainer_id);
+        f("experience", experience);
+        f("level", level);
+        f("ivs", ivs);
+        f("evs", evs);
+        f("moves", moves);
+    }
+
+    size_t rows() const {
+        return file.size();
+    }
+
+    //level is filled in for a whole batch by finish()
+    void add(uint32_t file_index, uint8_t save_slot_index, pokemon_location loc, uint8_t box_index, uint8_t slot_index, bool checksum_valid, const pokemon_box& decoded) {
+        file.push_back(file_index);
+        save_slot.push_back(save_slot_index);
+        location.push_back(loc);
+        box.push_back(box_index);
+        slot.push_back(slot_index);
+        valid.push_back(checksum_valid);
+        species.push_back(decoded.national_id());
+        personality.push_back(decoded.personality);
+        original_trainer_id.push_back(decoded.original_trainer_id);
+        experience.push_back(decoded.growth.experience);
+        ivs.push_back(decoded.ivs());
+        evs.push_back(decoded.evs());
+        moves.push_back(decoded.attacks.moves);
+    }
+
+    //computes the level column for every row added since the last call
+    void finish() {
+        size_t first = level.size();
+        std::vector<level_info> levels(rows() - first);
+        experience_to_level(std::span(species).subspan(first), std::span(experience).subspan(first), levels);
+        for (auto& l: levels) {
+            level.push_back(l.level);
+        }
+    }
+
+    //appends other's rows, renumbering its files after ours
+    void append(pokemon_columns& other) {
+        uint32_t file_base = files.size();
+        files.insert(files.end(), other.files.begin(), other.files.end());
+        size_t first = rows();
+        for_each_column([&](std::string_view name, auto& column) {
+            other.for_each_column([&](std::string_view other_name, auto& other_column) {
+                if constexpr (std::is_same_v<decltype(column), decltype(other_column)>) {
+                    if (name == other_name) {
+                        column.insert(column.end(), other_column.begin(), other_column.end());
+                    }
+                }
+            });
+        });
+        for (size_t i = first; i < rows(); i++) {
+            file[i] += file_base;
+        }
+    }
+
+    //written to a temporary file and renamed over path so readers never map half an export
+    void write(const std::string& path) {
+        std::vector<pokemon_column_entry> entries;
+        std::string file_names;
+        for (auto& f: files) {
+            file_names += f;
+            file_names.push_back('\0');
+        }
+        auto align = [](uint64_t x) { return (x + pokemon_column_alignment - 1) / pokemon_column_alignment * pokemon_column_alignment; };
+        uint64_t offset = sizeof(pokemon_columns_header);
+        for_each_column([&](std::string_view name, auto& column) {
+            pokemon_column_entry e{};
+            std::copy_n(name.begin(), std::min(name.size(), e.name.size() - 1), e.name.begin());
+            e.element_size = sizeof(column[0]);
+            e.size = column.size() * sizeof(column[0]);
+            entries.push_back(e);
+        });
+        offset += entries.size() * sizeof(pokemon_column_entry);
+        pokemon_columns_header header{
+            pokemon_columns_header::magic_value,
+            pokemon_columns_header::version_value,
+            rows(),
+            static_cast<uint32_t>(entries.size()),
+            static_cast<uint32_t>(files.size()),
+            offset,
+            file_names.size(),
+        };
+        offset += file_names.size();
+        for (auto& e: entries) {
+            e.offset = align(offset);
+            offset = e.offset + e.size;
+        }
+
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(pokemon_column_entry));
+            out.write(file_names.data(), file_names.size());
+            uint64_t position = header.file_names_offset + file_names.size();
+            size_t i = 0;
+            for_each_column([&](std::string_view, auto& column) {
+                static const std::array<char, pokemon_column_alignment> zeros{};
+                out.write(zeros.data(), entries[i].offset - position);
+                out.write(reinterpret_cast<const char*>(column.data()), entries[i].size);
+                position = entries[i].offset + entries[i].size;
+                i++;
+            });
+            if (!out) {
+                throw std::runtime_error(tmp + ": write failed");
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+    }
+};
+
+//a read-only mapping of an export, columns are handed out as spans straight into the mapping
+struct pokemon_columns_file {
+    mmap_file m;
+    const pokemon_columns_header* header;
+    std::span<const pokemon_column_entry> entries;
+    std::vector<std::string_view> files;
+
+    explicit pokemon_columns_file(const std::string& path):
+        m(path, mmap_mode::read_only)
+    {
+        if (m.data.size() < sizeof(pokemon_columns_header)) {
+            throw std::runtime_error(path + ": too small for a column file");
+        }
+        header = reinterpret_cast<const pokemon_columns_header*>(m.data.data());
+        if (header->magic != pokemon_columns_header::magic_value || header->version != pokemon_columns_header::version_value) {
+            throw std::runtime_error(path + ": not a version " + std::to_string(pokemon_columns_header::version_value) + " column file");
+        }
+        entries = span_cast<const pokemon_column_entry>(bytes(sizeof(pokemon_columns_header), header->num_columns * sizeof(pokemon_column_entry)));
+        auto names = bytes(header->file_names_offset, header->file_names_size);
+        std::string_view all(reinterpret_cast<const char*>(names.data()), names.size());
+        for (size_t start = 0; start < all.size();) {
+            size_t end = all.find('\0', start);
+            if (end == std::string_view::npos) {
+                throw std::runtime_error(path + ": unterminated file name");
+            }
+            files.push_back(all.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    std::span<const std::byte> bytes(uint64_t offset, uint64_t size) const {
+        if (offset > m.data.size() || size > m.data.size() - offset) {
+            throw std::runtime_error(m.filename + ": truncated column file");
+        }
+        return std::span<const std::byte>(m.data).subspan(offset, size);
+    }
+
+    size_t rows() const {
+        return header->rows;
+    }
+
+    template<typename T>
+    std::span<const T> column(std::string_view name) const {
+        for (auto& e: entries) {
+            if (name == e.name.data()) {
+                if (e.element_size != sizeof(T) || e.size != rows() * sizeof(T)) {
+                    throw std::runtime_error(m.filename + ": column " + std::string(name) + " has the wrong element size");
+                }
+                return span_cast<const T>(bytes(e.offset, e.size));
+            }
+        }
+        throw std::runtime_error(m.filename + ": no column " + std::string(name));
+    }
+};
@@ -0,0 +1,118 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "pokemon-box-kernels.hh"
+#include "pokemon-columns.hh"
+#include "thread-pool.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+//the party and pc of the latest save in one file, as rows of a single-file export
+pokemon_columns export_save(const std::string& filename) {
+    pokemon_columns columns;
+    columns.files.push_back(filename);
+    auto m = mmap_file(filename, mmap_mode::read_only);
+    auto d = save_payload(m.data);
+    auto& f = span_cast<pokemon_gen3_format>(d).front();
+    auto& save = f.check();
+    uint8_t save_slot = &save == &f.a ? 0 : 1;
+
+    auto team_items_section = static_cast<section_team_items&>(save.get_section_by_id(section_type::team_items));
+    auto party = team_items_section.get_pokemon_party(f.game_version(save));
+    for (size_t i = 0; i < party.size(); i++) {
+        pokemon_box decoded;
+        bool valid = decode_and_check(party[i], decoded);
+        columns.add(0, save_slot, pokemon_location::party, 0xff, i, valid, decoded);
+    }
+    decode_pc_buffer(pc_buffer_view(save), [&](const pokemon_box& decoded, size_t i, bool valid) {
+        columns.add(0, save_slot, pokemon_location::box, i / pc_buffer_view::slots_per_box, i % pc_buffer_view::slots_per_box, valid, decoded);
+    });
+    columns.finish();
+    return columns;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    std::string output;
+    output_format format = output_format::text;
+    std::vector<std::string> paths;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if ((args[i] == "--output" || args[i] == "-o") && i + 1 < args.size()) {
+                output = args[++i];
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                paths.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    output_buffer out;
+    if (output.empty() || paths.empty()) {
+        out << "usage: pokemon-export [--jobs N] [--format=text|jsonl] -o out.pkcol save_file_or_directory...\n";
+        return 1;
+    }
+
+    std::vector<std::string> filenames;
+    try {
+        filenames = collect_save_files(paths);
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+
+    //every file is exported on its own and the results are joined in argument order
+    std::vector<pokemon_columns> exported(filenames.size());
+    std::vector<std::string> errors(filenames.size());
+    {
+        thread_pool pool(jobs);
+        for (size_t i = 0; i < filenames.size(); i++) {
+            pool.submit([&, i] {
+                try {
+                    exported[i] = export_save(filenames[i]);
+                } catch (const std::runtime_error& e) {
+                    errors[i] = e.what();
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    pokemon_columns all;
+    size_t error_count = 0;
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (!errors[i].empty()) {
+            report_error(out, format, filenames[i], errors[i]);
+            error_count++;
+            continue;
+        }
+        all.append(exported[i]);
+        exported[i] = {};
+    }
+    try {
+        all.write(output);
+        if (format == output_format::jsonl) {
+            json_record(out).field("pokemon", all.rows()).field("files", all.files.size()).field("output", output).field("errors", error_count);
+        } else {
+            out << all.rows() << " pokemon from " << all.files.size() << " files written to " << output << ", " << error_count << " errors\n";
+        }
+        out.flush();
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return error_count == 0 ? 0 : 1;
+}
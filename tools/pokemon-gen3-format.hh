@@ -1,3 +1,5 @@
+#pragma once
+
 #include <span>
 #include <array>
 #include <cstddef>
@@ -5,10 +7,16 @@
 #include <algorithm>
 #include <utility>
 #include <optional>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "util.hh"
-#include "pokemon-names.hh"
-#include "species-id-conversion.hh"
+#include "stats.hh"
+#include "species-table.hh"
 #include "pokemon-strings.hh"
 #include "pokemon-levelling.hh"
 
@@ -25,8 +33,12 @@ const std::array<std::string, 4> game_version_strings = {
     "unknown game_version",
 };
 
+const std::string& game_version_string(enum game_version gv) {
+    return game_version_strings[std::min(static_cast<size_t>(gv), game_version_strings.size() - 1)];
+}
+
 std::ostream& operator<<(std::ostream& os, enum game_version gv) {
-    os << game_version_strings[std::min(static_cast<size_t>(gv), game_version_strings.size() - 1)];
+    os << game_version_string(gv);
     return os;
 }
 
@@ -49,7 +61,7 @@ enum section_type : uint16_t {
 
 constexpr auto num_sections = 14;
 
-std::array<size_t, num_sections> section_lengths = {
+constexpr std::array<size_t, num_sections> section_lengths = {
     3884,
     3968,
     3968,
@@ -84,23 +96,9 @@ static_assert(offsetof(section_game_state, _3) == 0x0405 + 1);
 static_assert(offsetof(section_game_state, _6) == 0x040B + 1);
 static_assert(offsetof(section_game_state, _7) == 0x049A + 1);
 
-#include "crc16_ccitt_table.hh"
-uint16_t crc16(std::span<std::byte> data) {
-    uint16_t v2 = 0x1121;
-    for (auto x: data) {
-        v2 = crc16_ccitt_table_16[(v2 ^ static_cast<uint8_t>(x)) % 256] ^ (v2 >> 8);
-    }
-    return ~v2;
-}
+#include "crc16.hh"
 
-uint16_t block_checksum(std::span<uint32_t> data) {
-    uint32_t sum = std::accumulate(data.begin(), data.end(), 0);
-    return sum + (sum >> 16);
-}
-
-uint16_t block_checksum(std::span<std::byte> data) {
-    return block_checksum(span_cast<uint32_t>(data));
-}
+#include "block-checksum.hh"
 
 struct section {
     std::array<std::byte, 4084> data;
@@ -119,9 +117,12 @@ struct section {
         return block_checksum(s);
     }
     void check() {
+        STATS_ADD(sections, 1);
         check_m(section_id < num_sections);
         check_m(signature == 0x08012025UL);
-        check_m(checksum == calculate_checksum());
+        uint16_t calculated = calculate_checksum();
+        STATS_ADD(checksum_failures, checksum != calculated);
+        check_m_f(checksum == calculated, "checksum == calculate_checksum()");
     }
 };
 static_assert(offsetof(section, signature) == 0x0FF8);
@@ -131,6 +132,7 @@ struct game_save {
     std::array<section, num_sections> sections;
 
     void check() {
+        STATS_SCOPE(check);
         for (auto& section: sections) {
             section.check();
         }
@@ -142,6 +144,15 @@ struct game_save {
         check_m(section_save_indexes_equal);
     }
 
+    bool valid() {
+        try {
+            check();
+            return true;
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+    }
+
     section& get_section_by_id(section_type id) {
         section& s = sections[(num_sections - sections[0].section_id + id) % num_sections];
         assert(s.section_id == id);
@@ -149,6 +160,7 @@ struct game_save {
     }
 
     std::vector<std::byte> get_sections_contiguous(section_type start, section_type end) {
+        STATS_SCOPE(sections_contiguous);
         end = static_cast<section_type>(end + 1);
         std::vector<std::byte> all_data;
         for (section_type i = start; i != end;
@@ -162,6 +174,90 @@ struct game_save {
 };
 static_assert(sizeof(game_save) == 0xE000);
 
+//records writes into the sections of a mapped save, on commit each dirty section is checksummed once
+//however many writes it got and only the dirty pages are synced
+struct edit_session {
+    struct dirty_section {
+        section* s;
+        std::vector<std::pair<size_t, size_t>> ranges;
+    };
+
+    //the whole mapping the sections live in, empty when they aren't backed by a file
+    std::span<std::byte> mapping;
+    std::vector<dirty_section> dirty;
+
+    explicit edit_session(std::span<std::byte> mapping_ = {}): mapping(mapping_) {}
+
+    dirty_section& track(section& s) {
+        for (auto& d: dirty) {
+            if (d.s == &s) {
+                return d;
+            }
+        }
+        dirty.push_back({&s, {}});
+        return dirty.back();
+    }
+
+    void write(section& s, size_t offset, std::span<const std::byte> bytes) {
+        check_m(offset + bytes.size() <= s.data.size());
+        auto& d = track(s);
+        std::memcpy(s.data.data() + offset, bytes.data(), bytes.size());
+        d.ranges.emplace_back(offset, bytes.size());
+    }
+
+    template<typename T>
+    void write(section& s, size_t offset, const T& value) {
+        write(s, offset, std::as_bytes(std::span(&value, 1)));
+    }
+
+    bool touched(const section& s) const {
+        return std::any_of(dirty.begin(), dirty.end(), [&](auto& d){ return d.s == &s; });
+    }
+
+    void update_checksums() {
+        for (auto& d: dirty) {
+            d.s->checksum = d.s->calculate_checksum();
+        }
+    }
+
+    void commit() {
+        update_checksums();
+        if (!mapping.empty()) {
+            sync_dirty_pages();
+        }
+        dirty.clear();
+    }
+
+    void sync_dirty_pages() {
+        const size_t page = sysconf(_SC_PAGESIZE);
+        auto base = reinterpret_cast<uintptr_t>(mapping.data());
+        std::vector<uintptr_t> pages;
+        for (auto& d: dirty) {
+            auto start = reinterpret_cast<uintptr_t>(d.s->data.data());
+            for (auto& [offset, length]: d.ranges) {
+                for (uintptr_t p = (start + offset) / page; p <= (start + offset + length - 1) / page; p++) {
+                    pages.push_back(p);
+                }
+            }
+            //the footer holding the checksum
+            pages.push_back(reinterpret_cast<uintptr_t>(&d.s->checksum) / page);
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        for (size_t i = 0; i < pages.size();) {
+            size_t j = i + 1;
+            while (j < pages.size() && pages[j] == pages[j - 1] + 1) {
+                j++;
+            }
+            uintptr_t from = std::max(pages[i] * page, base & ~(page - 1));
+            if (msync(reinterpret_cast<void*>(from), (pages[j - 1] + 1) * page - from, MS_SYNC) < 0) {
+                throw std::runtime_error(std::string("msync: ") + strerror(errno));
+            }
+            i = j;
+        }
+    }
+};
+
 struct mystery_gift_wonder_card {
     uint16_t checksum;
     uint16_t padding;
@@ -277,7 +373,7 @@ static_assert(sizeof(pokemon_data_attacks) == 12);
 static_assert(sizeof(pokemon_data_evs_condition) == 12);
 static_assert(sizeof(pokemon_data_misc) == 12);
         
-std::array<std::array<uint8_t, 4>, 24> pokemon_data_orders = {{
+constexpr std::array<std::array<uint8_t, 4>, 24> pokemon_data_orders = {{
     {0, 1, 2, 3},
     {0, 1, 3, 2},
     {0, 2, 1, 3},
@@ -304,59 +400,18 @@ std::array<std::array<uint8_t, 4>, 24> pokemon_data_orders = {{
     {3, 2, 1, 0},
 }};
 
-const std::string_view species_name(uint16_t national_id) {
-    const uint16_t n = national_id - 1;
-    if (n < pokemon_names.size()) {
-        return pokemon_names[n];
-    } else {
-        return "error";
-    }
-}
-
-constexpr std::pair<uint16_t, uint16_t> gen_id_range(uint8_t gen) {
-    if (gen == 1) {
-        return {1, 151};
-    } else if (gen == 2) {
-        return {152, 251};
-    } else if (gen == 3) {
-        return {252, 386};
-    } else {
-        return {};
-    }
-}
-
-constexpr uint8_t gen(uint16_t national_id) {
-    if (national_id <= 151) {
-        return 1;
-    } else if (national_id <= 251) {
-        return 2;
-    } else if (national_id <= 386) {
-        return 3;
-    } else {
-        throw "error";
+//inverse of pokemon_data_orders: where each of growth, attacks, evs_condition, misc is stored
+constexpr std::array<std::array<uint8_t, 4>, 24> make_pokemon_data_positions() {
+    std::array<std::array<uint8_t, 4>, 24> positions{};
+    for (size_t i = 0; i < positions.size(); i++) {
+        for (uint8_t position = 0; position < 4; position++) {
+            positions[i][pokemon_data_orders[i][position]] = position;
+        }
     }
+    return positions;
 }
 
-constexpr bool legendary(uint16_t national_id) {
-    return
-        (national_id >= 144 && national_id <= 146) || national_id == 150 ||
-        (national_id >= 243 && national_id <= 245) || national_id == 249 || national_id == 250 ||
-        (national_id >= 377 && national_id <= 384);
-}
-
-constexpr bool mythical(uint16_t national_id) {
-    return
-        national_id == 151 ||
-        national_id == 251 ||
-        national_id == 385 || national_id == 386;
-}
-
-constexpr bool starter(uint16_t national_id) {
-    return
-        (national_id >= 1 && national_id < 1 + 9) ||
-        (national_id >= 152 && national_id < 152 + 9) ||
-        (national_id >= 252 && national_id < 252 + 9);
-}
+constexpr std::array<std::array<uint8_t, 4>, 24> pokemon_data_positions = make_pokemon_data_positions();
 
 struct pokemon_box {
     uint32_t personality;
@@ -378,29 +433,52 @@ struct pokemon_box {
         };
     };
 
-    bool empty() {
+    bool empty() const {
         return personality == 0;
     }
 
     void decode() {
-        uint8_t index = personality % 24;
-        std::array<uint8_t, 4> order = pokemon_data_orders[index];
+        STATS_ADD(pokemon_decoded, 1);
+        const auto& position = pokemon_data_positions[personality % 24];
+        const auto encrypted = data;
         for (uint8_t i = 0; i < 4; i++) {
-            for (uint8_t j = i + 1; j < 4; j++) {
-                if (order[i] < order[j]) {
-                    continue;
-                } else {
-                    std::swap(data[i], data[j]);
-                    std::swap(order[i], order[j]);
-                }
-            }
+            data[i] = encrypted[position[i]];
         }
-        assert(std::is_sorted(order.begin(), order.end()));
         uint32_t decryption_key = original_trainer_id ^ personality;
         xor_bytes(span_bytes<pokemon_data_growth>(std::span(data)), decryption_key);
     }
-    void check() {
-        std::span<uint16_t, sizeof(data) / sizeof(uint16_t)> s{reinterpret_cast<uint16_t*>(&data), sizeof(data) / sizeof(uint16_t)};
+    //decrypted copy, leaves this (possibly mapped) entry untouched
+    pokemon_box decoded() const {
+        pokemon_box p = *this;
+        p.decode();
+        return p;
+    }
+
+    //the inverse of decode(), for writing a decrypted entry back
+    void encode() {
+        const auto& position = pokemon_data_positions[personality % 24];
+        uint32_t encryption_key = original_trainer_id ^ personality;
+        xor_bytes(span_bytes<pokemon_data_growth>(std::span(data)), encryption_key);
+        const auto decrypted = data;
+        for (uint8_t i = 0; i < 4; i++) {
+            data[position[i]] = decrypted[i];
+        }
+    }
+
+    pokemon_box encoded() const {
+        pokemon_box p = *this;
+        p.encode();
+        return p;
+    }
+
+    //on a decrypted entry, makes the stored checksum match the data
+    void update_checksum() {
+        auto words = span_cast<uint16_t>(data);
+        checksum = std::accumulate(words.begin(), words.end(), uint16_t{0});
+    }
+
+    void check() const {
+        std::span<const uint16_t, sizeof(data) / sizeof(uint16_t)> s{reinterpret_cast<const uint16_t*>(&data), sizeof(data) / sizeof(uint16_t)};
 
         uint16_t sum = std::accumulate(s.begin(), s.end(), 0);
         if (sum != checksum) {
@@ -416,10 +494,38 @@ struct pokemon_box {
         return pokemon_string_to_string(original_trainer_name);
     }
 
+    void set_nickname(std::string_view s) {
+        string_to_pokemon_string(s, nickname);
+    }
+
+    void set_original_trainer_name(std::string_view s) {
+        string_to_pokemon_string(s, original_trainer_name);
+    }
+
     uint8_t level() const {
         return experience_to_level(national_id(), growth.experience);
     }
 
+    uint32_t experience_to_next_level() const {
+        return ::experience_to_next_level(national_id(), growth.experience);
+    }
+
+    //hp, attack, defense, speed, sp. attack, sp. defense, 5 bits each
+    std::array<uint8_t, 6> ivs() const {
+        std::array<uint8_t, 6> ivs;
+        for (size_t i = 0; i < ivs.size(); i++) {
+            ivs[i] = (misc.iv_egg_ability >> (5 * i)) & 0b11111;
+        }
+        return ivs;
+    }
+
+    std::array<uint8_t, 6> evs() const {
+        return {
+            evs_condition.hp_ev, evs_condition.attack_ev, evs_condition.defense_ev,
+            evs_condition.speed_ev, evs_condition.sp_attack_ev, evs_condition.sp_defense_ev,
+        };
+    }
+
     bool shiny() const {
         uint32_t x = personality ^ original_trainer_id;
         uint16_t y = (x >> 16) ^ x;
@@ -460,7 +566,7 @@ struct pokemon_box {
         return internal_to_national(growth.species);
     }
 
-    const std::string_view species_name() const {
+    std::string_view species_name() const {
         return ::species_name(national_id());
     }
 };
@@ -476,6 +582,18 @@ struct pokemon_party: pokemon_box {
     uint16_t speed;
     uint16_t sp_attack;
     uint16_t sp_defense;
+
+    pokemon_party decoded() const {
+        pokemon_party p = *this;
+        p.decode();
+        return p;
+    }
+
+    pokemon_party encoded() const {
+        pokemon_party p = *this;
+        p.encode();
+        return p;
+    }
 };
 
 std::ostream& operator<<(std::ostream& os, const pokemon_party& p) {
@@ -498,6 +616,100 @@ struct sections_pc_buffer {
 static_assert(sizeof(pokemon_party) == 100);
 static_assert(sizeof(pokemon_box) == 80);
 
+//sections_pc_buffer addressed in place across the rotated pc_buffer_a..i sections of a save,
+//an entry that straddles two sections is handed out through a stack bounce buffer instead
+struct pc_buffer_view {
+    static constexpr size_t num_boxes = 14;
+    static constexpr size_t slots_per_box = 30;
+    static constexpr size_t size = num_boxes * slots_per_box;
+
+    std::array<section*, section_type::pc_buffer_i - section_type::pc_buffer_a + 1> sections;
+
+    pc_buffer_view(game_save& save) {
+        for (size_t i = 0; i < sections.size(); i++) {
+            sections[i] = &save.get_section_by_id(static_cast<section_type>(section_type::pc_buffer_a + i));
+        }
+    }
+
+    //calls f(pokemon_box&) on entry i, changes made to a bounced entry are written back
+    template<typename F>
+    void visit(size_t i, F&& f) {
+        assert(i < size);
+        constexpr size_t stride = section_lengths[section_type::pc_buffer_a];
+        size_t offset = offsetof(sections_pc_buffer, pc_buffer_pokemon) + i * sizeof(pokemon_box);
+        size_t n = offset / stride;
+        size_t within = offset % stride;
+        if (within + sizeof(pokemon_box) <= stride) {
+            f(*reinterpret_cast<pokemon_box*>(sections[n]->data.data() + within));
+            return;
+        }
+        const size_t head = stride - within;
+        std::byte* first = sections[n]->data.data() + within;
+        std::byte* second = sections[n + 1]->data.data();
+        alignas(pokemon_box) std::array<std::byte, sizeof(pokemon_box)> bounce;
+        std::memcpy(bounce.data(), first, head);
+        std::memcpy(bounce.data() + head, second, sizeof(pokemon_box) - head);
+        f(*reinterpret_cast<pokemon_box*>(bounce.data()));
+        //only write back when something changed so read-only mappings can be visited too
+        if (std::memcmp(bounce.data(), first, head) != 0) {
+            std::memcpy(first, bounce.data(), head);
+        }
+        if (std::memcmp(bounce.data() + head, second, sizeof(pokemon_box) - head) != 0) {
+            std::memcpy(second, bounce.data() + head, sizeof(pokemon_box) - head);
+        }
+    }
+
+    //calls f(const pokemon_box&) on entry i, a bounced entry is only ever read
+    template<typename F>
+    void visit(size_t i, F&& f) const {
+        assert(i < size);
+        constexpr size_t stride = section_lengths[section_type::pc_buffer_a];
+        size_t offset = offsetof(sections_pc_buffer, pc_buffer_pokemon) + i * sizeof(pokemon_box);
+        size_t n = offset / stride;
+        size_t within = offset % stride;
+        if (within + sizeof(pokemon_box) <= stride) {
+            f(*reinterpret_cast<const pokemon_box*>(sections[n]->data.data() + within));
+            return;
+        }
+        const size_t head = stride - within;
+        alignas(pokemon_box) std::array<std::byte, sizeof(pokemon_box)> bounce;
+        std::memcpy(bounce.data(), sections[n]->data.data() + within, head);
+        std::memcpy(bounce.data() + head, sections[n + 1]->data.data(), sizeof(pokemon_box) - head);
+        f(*reinterpret_cast<const pokemon_box*>(bounce.data()));
+    }
+
+    template<typename F>
+    void visit(size_t box, size_t slot, F&& f) {
+        visit(box * slots_per_box + slot, std::forward<F>(f));
+    }
+
+    template<typename F>
+    void visit(size_t box, size_t slot, F&& f) const {
+        visit(box * slots_per_box + slot, std::forward<F>(f));
+    }
+
+    //calls f(pokemon_box&, index) on every entry in box/slot order
+    template<typename F>
+    void for_each(F&& f) {
+        for (size_t i = 0; i < size; i++) {
+            visit(i, [&](pokemon_box& p){ f(p, i); });
+        }
+    }
+
+    template<typename F>
+    void for_each(F&& f) const {
+        for (size_t i = 0; i < size; i++) {
+            visit(i, [&](const pokemon_box& p){ f(p, i); });
+        }
+    }
+
+    pokemon_box operator[](size_t i) const {
+        pokemon_box p;
+        visit(i, [&](const pokemon_box& q){ p = q; });
+        return p;
+    }
+};
+
 struct section_trainer_info: public section {
     enum game_version game_version() {
         uint32_t game_code = span_cast<uint32_t>(data_span().subspan(0xac, 4)).front();
@@ -540,41 +752,104 @@ struct pokemon_gen3_format {
     std::array<std::byte, 4096> mystery_gift;
     std::array<std::byte, 4096> recorded_battle;
 
-    void check() {
-        if (a.sections.back().save_index != 0xffffffff) {
-            a.check();
+    //picks the latest save like the game does and returns it, keep it rather than asking again: the
+    //newer slot if it is intact, otherwise the older one, so a save that was interrupted part way
+    //still opens with the previous one. throws with neither intact
+    game_save& check() {
+        game_save& newer = get_newer_game_save();
+        game_save& older = get_other_game_save(newer);
+        if (newer.valid()) {
+            return newer;
+        }
+        if (older.sections.back().save_index != 0xffffffff && older.valid()) {
+            return older;
         }
-        b.check();
+        newer.check();
+        return newer;
     }
 
-    game_save& get_latest_game_save() {
-        if (a.sections.back().save_index > b.sections.back().save_index) {
-            return a;
-        } else {
-            return b;
+    //the slot with the higher save_index, whether or not it is intact. a slot that was never
+    //written is all 0xff and never the newer one
+    game_save& get_newer_game_save() {
+        uint32_t index_a = a.sections.back().save_index;
+        uint32_t index_b = b.sections.back().save_index;
+        if (index_a == 0xffffffff || index_b == 0xffffffff) {
+            return index_a == 0xffffffff ? b : a;
         }
+        return index_a > index_b ? a : b;
     }
 
-    enum game_version game_version() {
-        auto trainer_info = static_cast<section_trainer_info>(get_latest_game_save().get_section_by_id(section_type::trainer_info));
+    game_save& get_other_game_save(game_save& save) {
+        return &save == &a ? b : a;
+    }
+
+    enum game_version game_version(game_save& save) {
+        auto trainer_info = static_cast<section_trainer_info>(save.get_section_by_id(section_type::trainer_info));
         return trainer_info.game_version();
     }
 
-    void write_mystery_gift(mystery_gift_file_format& mg) {
-        section& s = get_latest_game_save().get_section_by_id(section_type::rival_info);
-        if (game_version() == game_version::leafgreen_firered) {
-            auto d = reinterpret_cast<mystery_gift_save_format_frlg*>(s.data.data());
-            d->wonder_card = mg.wonder_card;
-            d->event_script = mg.event_script;
-        } else if (game_version() == game_version::emerald) {
-            auto d = reinterpret_cast<mystery_gift_save_format_emerald*>(s.data.data());
-            d->wonder_card = mg.wonder_card;
-            d->event_script = mg.event_script;
+    void write_mystery_gift(game_save& save, const mystery_gift_file_format& mg, edit_session& session) {
+        section& s = save.get_section_by_id(section_type::rival_info);
+        if (game_version(save) == game_version::leafgreen_firered) {
+            session.write(s, offsetof(mystery_gift_save_format_frlg, wonder_card), mg.wonder_card);
+            session.write(s, offsetof(mystery_gift_save_format_frlg, event_script), mg.event_script);
+        } else if (game_version(save) == game_version::emerald) {
+            session.write(s, offsetof(mystery_gift_save_format_emerald, wonder_card), mg.wonder_card);
+            session.write(s, offsetof(mystery_gift_save_format_emerald, event_script), mg.event_script);
         }
-        s.checksum = s.calculate_checksum();
     }
 };
 
 static_assert(offsetof(pokemon_gen3_format, a) == 0);
 static_assert(offsetof(pokemon_gen3_format, b) == 0xE000);
 static_assert(sizeof(pokemon_gen3_format) == 128 * 1024);
+
+//saves the way the game does: the latest save is copied into the other slot with its sections
+//rotated one further and save_index bumped, edits go into that copy, and the previous save stays
+//untouched until the new one is on disk, a crash part way leaves an invalid newer slot which
+//check() skips in favour of the intact one
+struct slot_writer {
+    pokemon_gen3_format& f;
+    std::span<std::byte> mapping;
+    int fd;
+    edit_session session;
+    game_save* target = nullptr;
+
+    slot_writer(pokemon_gen3_format& f_, std::span<std::byte> mapping_, int fd_):
+        f(f_), mapping(mapping_), fd(fd_)
+    {}
+
+    game_save& begin() {
+        game_save& latest = f.check();
+        game_save& next = f.get_other_game_save(latest);
+        const uint32_t save_index = latest.sections.back().save_index + 1;
+        const auto first_id = static_cast<section_type>((latest.sections[0].section_id + num_sections - 1) % num_sections);
+        for (size_t i = 0; i < num_sections; i++) {
+            auto id = static_cast<section_type>((first_id + i) % num_sections);
+            next.sections[i] = latest.get_section_by_id(id);
+            next.sections[i].save_index = save_index;
+        }
+        target = &next;
+        return next;
+    }
+
+    void commit() {
+        check_m(target != nullptr);
+        //only the edited sections need new checksums, the rest were copied along with theirs
+        session.update_checksums();
+        session.dirty.clear();
+        target->check();
+        if (!mapping.empty()) {
+            const uintptr_t page = sysconf(_SC_PAGESIZE);
+            auto start = reinterpret_cast<uintptr_t>(target) & ~(page - 1);
+            auto end = reinterpret_cast<uintptr_t>(target) + sizeof(game_save);
+            if (msync(reinterpret_cast<void*>(start), end - start, MS_SYNC) < 0) {
+                throw std::runtime_error(std::string("msync: ") + strerror(errno));
+            }
+        }
+        if (fd >= 0 && fsync(fd) < 0) {
+            throw std::runtime_error(std::string("fsync: ") + strerror(errno));
+        }
+        target = nullptr;
+    }
+};
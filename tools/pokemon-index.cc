@@ -0,0 +1,175 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "pokemon-index.hh"
+#include "pokemon-query.hh"
+#include "thread-pool.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+int update(output_buffer& out, output_format format, const std::string& index_path, const std::vector<std::string>& paths, size_t jobs) {
+    std::vector<std::string> filenames = collect_save_files(paths);
+    pokemon_index old(index_path);
+    std::unordered_map<std::string_view, const pokemon_index_file*> old_files;
+    for (auto& f: old.files) {
+        old_files.emplace(old.filename(f), &f);
+    }
+
+    //only files whose identity or section footers changed are decoded again
+    std::vector<pokemon_index_source> sources(filenames.size());
+    std::vector<std::string> errors(filenames.size());
+    std::atomic<size_t> reused = 0;
+    {
+        thread_pool pool(jobs);
+        for (size_t i = 0; i < filenames.size(); i++) {
+            pool.submit([&, i] {
+                auto& s = sources[i];
+                s.filename = filenames[i];
+                try {
+                    auto m = mmap_file(s.filename, mmap_mode::read_only);
+                    s.identity = file_identity::of(m.fd, s.filename);
+                    s.footer_hash = footer_hash(m.data);
+                    auto it = old_files.find(s.filename);
+                    if (it != old_files.end() && it->second->identity == s.identity && it->second->footer_hash == s.footer_hash) {
+                        auto e = old.entries_of(*it->second);
+                        s.entries.assign(e.begin(), e.end());
+                        reused++;
+                    } else {
+                        s.entries = index_save(m.data);
+                    }
+                } catch (const std::runtime_error& e) {
+                    errors[i] = e.what();
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    std::vector<pokemon_index_source> indexed;
+    size_t error_count = 0;
+    size_t pokemon = 0;
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (!errors[i].empty()) {
+            report_error(out, format, filenames[i], errors[i]);
+            error_count++;
+            continue;
+        }
+        pokemon += sources[i].entries.size();
+        indexed.push_back(std::move(sources[i]));
+    }
+    //only decoding is incremental: any change rewrites the whole index, an unchanged corpus leaves it alone
+    bool unchanged = old.m && reused == indexed.size() && indexed.size() == old.files.size();
+    for (size_t i = 0; unchanged && i < indexed.size(); i++) {
+        unchanged = old.filename(old.files[i]) == indexed[i].filename;
+    }
+    if (!unchanged) {
+        write_pokemon_index(index_path, indexed);
+    }
+    if (format == output_format::jsonl) {
+        json_record(out).field("files", indexed.size()).field("decoded", indexed.size() - reused).field("unchanged", reused.load())
+            .field("pokemon", pokemon).field("errors", error_count);
+    } else {
+        out << indexed.size() << " files indexed (" << indexed.size() - reused << " decoded, " << reused.load() << " unchanged), "
+            << pokemon << " pokemon, " << error_count << " errors\n";
+    }
+    out.flush();
+    return error_count == 0 ? 0 : 1;
+}
+
+int lookup(output_buffer& out, output_format format, const std::string& index_path, std::string_view kind_name, std::string_view value) {
+    pokemon_index index(index_path);
+    pokemon_index_key_kind kind;
+    query_field field;
+    if (kind_name == "species") {
+        kind = pokemon_index_key_kind::species;
+        field = query_field::species;
+    } else if (kind_name == "pid" || kind_name == "personality") {
+        kind = pokemon_index_key_kind::personality;
+        field = query_field::personality;
+    } else if (kind_name == "otid" || kind_name == "original_trainer_id") {
+        kind = pokemon_index_key_kind::original_trainer_id;
+        field = query_field::original_trainer_id;
+    } else {
+        throw std::runtime_error("unknown key " + std::string(kind_name) + ", expected species, pid or otid");
+    }
+    auto postings = index.lookup(kind, query_parser{value}.value_for(field, value));
+    for (auto& p: postings) {
+        auto& f = index.file(p.file);
+        auto file_entries = index.entries_of(f);
+        auto it = std::find_if(file_entries.begin(), file_entries.end(), [&](auto& e) {
+            return e.box == p.box && e.slot == p.slot;
+        });
+        if (it == file_entries.end()) {
+            throw std::runtime_error(index_path + ": corrupt posting");
+        }
+        auto& e = *it;
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            record.field("file", index.filename(f)).field("save_slot", p.save_slot ? "b" : "a");
+            if (p.box == 0xff) {
+                record.field("location", "party");
+            } else {
+                record.field("location", "box").field("box", p.box);
+            }
+            record.field("slot", p.slot).field("species", species_name(e.species))
+                .field("personality", e.personality).field("original_trainer_id", e.original_trainer_id);
+            continue;
+        }
+        out << index.filename(f) << '\t' << (p.save_slot ? "b" : "a") << '\t';
+        if (p.box == 0xff) {
+            out << "party\t-\t";
+        } else {
+            out << "box\t" << p.box << '\t';
+        }
+        out << p.slot << '\t' << species_name(e.species) << '\n';
+    }
+    if (format == output_format::jsonl) {
+        json_record(out).field("found", postings.size());
+    } else {
+        out << postings.size() << " found\n";
+    }
+    out.flush();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    output_format format = output_format::text;
+    std::vector<std::string> rest;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                rest.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    output_buffer out;
+    try {
+        if (rest.size() >= 3 && rest[0] == "update") {
+            return update(out, format, rest[1], std::vector(rest.begin() + 2, rest.end()), jobs);
+        } else if (rest.size() == 4 && rest[0] == "lookup") {
+            return lookup(out, format, rest[1], rest[2], rest[3]);
+        }
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+    out << "usage: pokemon-index [--jobs N] [--format=text|jsonl] update index-file save_file_or_directory...\n";
+    out << "       pokemon-index [--format=text|jsonl] lookup index-file species|pid|otid value\n";
+    return 1;
+}
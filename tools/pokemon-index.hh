@@ -0,0 +1,312 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+
+#include "mmap.hh"
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "pokemon-box-kernels.hh"
+#include "validation-cache.hh"
+
+enum class pokemon_index_key_kind: uint8_t {
+    species = 1,
+    personality,
+    original_trainer_id,
+};
+
+constexpr uint64_t pokemon_index_key(pokemon_index_key_kind kind, uint32_t value) {
+    return static_cast<uint64_t>(kind) << 32 | value;
+}
+
+//every pokemon of one file, the forward half of the index that lets an update carry unchanged
+//files over without opening them again
+struct pokemon_index_entry {
+    uint32_t personality;
+    uint32_t original_trainer_id;
+    uint16_t species;
+    //0 for save slot a, 1 for b
+    uint8_t save_slot;
+    //0xff in the party
+    uint8_t box;
+    uint8_t slot;
+    std::array<uint8_t, 3> _;
+};
+
+struct pokemon_index_file {
+    file_identity identity;
+    uint64_t footer_hash;
+    uint64_t name_offset;
+    uint32_t name_size;
+    uint32_t first_entry;
+    uint32_t num_entries;
+    uint32_t _;
+};
+
+//where a key was found
+struct pokemon_index_posting {
+    uint32_t file;
+    uint8_t save_slot;
+    uint8_t box;
+    uint8_t slot;
+    uint8_t _;
+};
+
+//open addressing with linear probing, key 0 marks an empty bucket
+struct pokemon_index_bucket {
+    uint64_t key;
+    uint32_t first_posting;
+    uint32_t num_postings;
+};
+
+//on disk: the header, the file table, the file names, the forward entries, the buckets and then
+//the postings grouped by key. a lookup hashes the key, probes a few buckets and reads one run of
+//postings, so it costs the same however many saves are indexed
+struct pokemon_index_header {
+    static constexpr uint32_t magic_value = 0x58494b50; //"PKIX"
+    static constexpr uint32_t version_value = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_files;
+    uint32_t num_entries;
+    uint32_t num_buckets;
+    uint32_t num_postings;
+    uint64_t files_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t postings_offset;
+};
+
+static_assert(sizeof(pokemon_index_entry) == 16);
+static_assert(sizeof(pokemon_index_file) == 64);
+static_assert(sizeof(pokemon_index_posting) == 8);
+static_assert(sizeof(pokemon_index_bucket) == 16);
+static_assert(sizeof(pokemon_index_header) == 72);
+
+constexpr size_t pokemon_index_bucket_of(uint64_t key, size_t num_buckets) {
+    //fibonacci hashing, num_buckets is a power of two
+    return (key * 0x9e3779b97f4a7c15) >> (64 - std::countr_zero(num_buckets));
+}
+
+//the index of one file as it is built or carried over
+struct pokemon_index_source {
+    std::string filename;
+    file_identity identity;
+    uint64_t footer_hash;
+    std::vector<pokemon_index_entry> entries;
+};
+
+//the party and pc of the latest save, with their locations
+std::vector<pokemon_index_entry> index_save(std::span<std::byte> d) {
+    d = save_payload(d);
+    auto& f = span_cast<pokemon_gen3_format>(d).front();
+    auto& save = f.check();
+    uint8_t save_slot = &save == &f.a ? 0 : 1;
+
+    std::vector<pokemon_index_entry> entries;
+    auto team_items_section = static_cast<section_team_items&>(save.get_section_by_id(section_type::team_items));
+    auto party = team_items_section.get_pokemon_party(f.game_version(save));
+    for (size_t i = 0; i < party.size(); i++) {
+        pokemon_box decoded;
+        decode_and_check(party[i], decoded);
+        entries.push_back({decoded.personality, decoded.original_trainer_id, decoded.national_id(), save_slot, 0xff, static_cast<uint8_t>(i), {}});
+    }
+    decode_pc_buffer(pc_buffer_view(save), [&](const pokemon_box& decoded, size_t i, bool) {
+        entries.push_back({
+            decoded.personality, decoded.original_trainer_id, decoded.national_id(), save_slot,
+            static_cast<uint8_t>(i / pc_buffer_view::slots_per_box), static_cast<uint8_t>(i % pc_buffer_view::slots_per_box), {},
+        });
+    });
+    return entries;
+}
+
+//a read-only mapping of an index file, a missing file reads as an empty index. opening it checks
+//only the header and the section sizes, the records are checked as they are used so a lookup
+//doesn't read the whole index
+struct pokemon_index {
+    std::optional<mmap_file> m;
+    const pokemon_index_header* header = nullptr;
+    std::span<const pokemon_index_file> files;
+    std::span<const pokemon_index_entry> entries;
+    std::span<const pokemon_index_bucket> buckets;
+    std::span<const pokemon_index_posting> postings;
+    std::string_view names;
+
+    explicit pokemon_index(const std::string& path) {
+        if (access(path.c_str(), F_OK) != 0) {
+            return;
+        }
+        m.emplace(path, mmap_mode::read_only);
+        if (m->data.size() < sizeof(pokemon_index_header)) {
+            throw std::runtime_error(path + ": too small for an index");
+        }
+        header = reinterpret_cast<const pokemon_index_header*>(m->data.data());
+        if (header->magic != pokemon_index_header::magic_value || header->version != pokemon_index_header::version_value) {
+            throw std::runtime_error(path + ": not a version " + std::to_string(pokemon_index_header::version_value) + " index");
+        }
+        files = section<pokemon_index_file>(header->files_offset, header->num_files);
+        entries = section<pokemon_index_entry>(header->entries_offset, header->num_entries);
+        buckets = section<pokemon_index_bucket>(header->buckets_offset, header->num_buckets);
+        postings = section<pokemon_index_posting>(header->postings_offset, header->num_postings);
+        auto n = section<char>(header->names_offset, header->names_size);
+        names = {n.data(), n.size()};
+        //an empty index has no buckets, otherwise pokemon_index_bucket_of needs at least two
+        if (!buckets.empty() && (buckets.size() < 2 || !std::has_single_bit(buckets.size()))) {
+            throw std::runtime_error(path + ": bucket count is not a power of two of at least 2");
+        }
+    }
+
+    template<typename T>
+    std::span<const T> section(uint64_t offset, uint64_t count) const {
+        if (offset > m->data.size() || count > (m->data.size() - offset) / sizeof(T)) {
+            throw std::runtime_error(m->filename + ": truncated index");
+        }
+        return {reinterpret_cast<const T*>(m->data.data() + offset), count};
+    }
+
+    const pokemon_index_file& file(uint32_t i) const {
+        if (i >= files.size()) {
+            throw std::runtime_error(m->filename + ": corrupt posting");
+        }
+        return files[i];
+    }
+
+    std::string_view filename(const pokemon_index_file& f) const {
+        if (f.name_offset > names.size() || f.name_size > names.size() - f.name_offset) {
+            throw std::runtime_error(m->filename + ": corrupt file table");
+        }
+        return names.substr(f.name_offset, f.name_size);
+    }
+
+    std::span<const pokemon_index_entry> entries_of(const pokemon_index_file& f) const {
+        if (f.first_entry + uint64_t{f.num_entries} > entries.size()) {
+            throw std::runtime_error(m->filename + ": corrupt file table");
+        }
+        return entries.subspan(f.first_entry, f.num_entries);
+    }
+
+    std::span<const pokemon_index_posting> lookup(pokemon_index_key_kind kind, uint32_t value) const {
+        if (buckets.empty()) {
+            return {};
+        }
+        uint64_t key = pokemon_index_key(kind, value);
+        size_t b = pokemon_index_bucket_of(key, buckets.size());
+        for (size_t probes = 0; probes < buckets.size(); probes++, b = (b + 1) & (buckets.size() - 1)) {
+            if (buckets[b].key == key) {
+                if (buckets[b].first_posting + uint64_t{buckets[b].num_postings} > postings.size()) {
+                    throw std::runtime_error(m->filename + ": corrupt bucket");
+                }
+                return postings.subspan(buckets[b].first_posting, buckets[b].num_postings);
+            }
+            if (buckets[b].key == 0) {
+                return {};
+            }
+        }
+        //the writer leaves at least half the buckets empty
+        throw std::runtime_error(m->filename + ": corrupt bucket table");
+    }
+};
+
+//writes the index of sources, in their order, to a temporary file renamed over path
+void write_pokemon_index(const std::string& path, const std::vector<pokemon_index_source>& sources) {
+    std::vector<pokemon_index_file> files;
+    std::vector<pokemon_index_entry> entries;
+    std::string names;
+    for (auto& s: sources) {
+        files.push_back({s.identity, s.footer_hash, names.size(), static_cast<uint32_t>(s.filename.size()), static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(s.entries.size()), 0});
+        names += s.filename;
+        entries.insert(entries.end(), s.entries.begin(), s.entries.end());
+    }
+
+    //every entry posts under its species, personality and ot id
+    struct keyed_posting {
+        uint64_t key;
+        pokemon_index_posting posting;
+    };
+    std::vector<keyed_posting> keyed;
+    keyed.reserve(entries.size() * 3);
+    for (uint32_t fi = 0; fi < files.size(); fi++) {
+        for (uint32_t i = files[fi].first_entry; i < files[fi].first_entry + files[fi].num_entries; i++) {
+            auto& e = entries[i];
+            pokemon_index_posting p{fi, e.save_slot, e.box, e.slot, 0};
+            keyed.push_back({pokemon_index_key(pokemon_index_key_kind::species, e.species), p});
+            keyed.push_back({pokemon_index_key(pokemon_index_key_kind::personality, e.personality), p});
+            keyed.push_back({pokemon_index_key(pokemon_index_key_kind::original_trainer_id, e.original_trainer_id), p});
+        }
+    }
+    //stable so postings stay in file, then box/slot order
+    std::stable_sort(keyed.begin(), keyed.end(), [](auto& a, auto& b) { return a.key < b.key; });
+
+    size_t distinct = 0;
+    for (size_t i = 0; i < keyed.size(); i++) {
+        distinct += i == 0 || keyed[i].key != keyed[i - 1].key;
+    }
+    //at most half full keeps probe sequences short
+    std::vector<pokemon_index_bucket> buckets(distinct ? std::bit_ceil(distinct * 2) : 0);
+    std::vector<pokemon_index_posting> postings;
+    postings.reserve(keyed.size());
+    for (size_t i = 0; i < keyed.size();) {
+        size_t j = i;
+        while (j < keyed.size() && keyed[j].key == keyed[i].key) {
+            postings.push_back(keyed[j].posting);
+            j++;
+        }
+        size_t b = pokemon_index_bucket_of(keyed[i].key, buckets.size());
+        while (buckets[b].key != 0) {
+            b = (b + 1) & (buckets.size() - 1);
+        }
+        buckets[b] = {keyed[i].key, static_cast<uint32_t>(i), static_cast<uint32_t>(j - i)};
+        i = j;
+    }
+
+    auto align = [](uint64_t x) { return (x + 7) / 8 * 8; };
+    pokemon_index_header header{};
+    header.magic = pokemon_index_header::magic_value;
+    header.version = pokemon_index_header::version_value;
+    header.num_files = files.size();
+    header.num_entries = entries.size();
+    header.num_buckets = buckets.size();
+    header.num_postings = postings.size();
+    header.files_offset = sizeof(header);
+    header.names_offset = header.files_offset + files.size() * sizeof(pokemon_index_file);
+    header.names_size = names.size();
+    header.entries_offset = align(header.names_offset + names.size());
+    header.buckets_offset = header.entries_offset + entries.size() * sizeof(pokemon_index_entry);
+    header.postings_offset = header.buckets_offset + buckets.size() * sizeof(pokemon_index_bucket);
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        auto write = [&](const auto& v) {
+            out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(v[0]));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write(files);
+        write(names);
+        out.write("\0\0\0\0\0\0\0", header.entries_offset - header.names_offset - names.size());
+        write(entries);
+        write(buckets);
+        write(postings);
+        if (!out) {
+            throw std::runtime_error(tmp + ": write failed");
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        throw std::runtime_error(path + ": " + strerror(errno));
+    }
+}
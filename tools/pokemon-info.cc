@@ -9,93 +9,203 @@
 #include <cassert>
 
 #include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "pokemon-box-kernels.hh"
+#include "dex-summary.hh"
+#include "thread-pool.hh"
 #include "util.hh"
+#include "output.hh"
+#include "stats.hh"
 
-int main(int argc, char* argv[]) {
-    std::vector<std::string> args(argv + 1, argv + argc);
-    std::bitset<gen_id_range(3).second + 1> dex;
-    std::bitset<28> unowns{};
-    for (auto& filename: args) {
-        try {
-            auto m = mmap_file(filename, false);
-            auto d = m.data;
-            if (d.size() != 32 * 4096) {
-                throw std::runtime_error("wrong save file size");
-            }
-            auto f = span_cast<pokemon_gen3_format>(d).front();
-            f.check();
-            auto& save = f.get_latest_game_save();
-            save.check();
+struct file_report {
+    std::string text;
+    dex_summary summary;
+};
 
-            {
-                auto trainer_info = static_cast<section_trainer_info>(save.get_section_by_id(section_type::trainer_info));
-                for (uint16_t n = gen_id_range(1).first; n <= gen_id_range(3).second; n++) {
-                    if (trainer_info.pokedex_owned(n)) {
-                        dex.set(n);
-                    }
-                }
-            }
-            {
-                auto team_items_section = static_cast<section_team_items>(save.get_section_by_id(section_type::team_items));
-                auto game_version = f.game_version();
-                auto party_pokemon = team_items_section.get_pokemon_party(game_version);
-                std::cout << "party:" << std::endl;
-                for (auto& pokemon: party_pokemon) {
-                    pokemon.decode();
-                    pokemon.check();
-                    dex.set(pokemon.national_id());
-                    const auto uf = pokemon.unown_form();
-                    if (uf) {
-                        unowns.set(*uf);
-                    }
-                    std::cout << pokemon << std::endl;
-                }
+//one line or one json record per pokemon
+void report_pokemon(output_buffer& out, output_format format, const std::string& filename, std::string_view location, size_t slot, uint8_t level, const pokemon_box& pokemon) {
+    if (format == output_format::text) {
+        out << "level " << level << ' ' << pokemon.species_name() << '\n';
+        return;
+    }
+    json_record record(out);
+    record.field("file", filename).field("location", location);
+    if (location == "box") {
+        record.field("box", slot / pc_buffer_view::slots_per_box).field("slot", slot % pc_buffer_view::slots_per_box);
+    } else {
+        record.field("slot", slot);
+    }
+    record.field("level", level).field("species", pokemon.species_name()).field("national_id", pokemon.national_id())
+        .field("personality", pokemon.personality).field("original_trainer_id", pokemon.original_trainer_id)
+        .field("shiny", pokemon.shiny());
+    if (auto uf = pokemon.unown_form()) {
+        record.field("unown", unown_letters.substr(*uf, 1));
+    }
+}
+
+//a pokemon as it was decoded, listed after the whole save is decoded so the listing is timed as
+//output rather than as decoding
+struct listed_pokemon {
+    std::string_view location;
+    size_t slot;
+    //a party pokemon's stored level, box pokemon have theirs worked out from the experience
+    uint8_t level;
+    pokemon_box pokemon;
+};
+
+file_report info_file(const std::string& filename, output_format format) {
+    file_report r;
+    output_buffer out(-1);
+    try {
+        auto m = mmap_file(filename, mmap_mode::read_only);
+        auto d = save_payload(m.data);
+        auto& f = span_cast<pokemon_gen3_format>(d).front();
+        auto& save = f.check();
+
+        std::vector<listed_pokemon> listed;
+        size_t party_size = 0;
+        r.summary = summarize_save(f, save, [&](std::string_view location, size_t slot, uint8_t level, const pokemon_box& pokemon) {
+            party_size += location == "party";
+            listed.push_back({location, slot, level, pokemon});
+        });
+
+        STATS_SCOPE(output);
+        if (format == output_format::text) {
+            out << "party:\n";
+        }
+        for (size_t i = 0; i < listed.size(); i++) {
+            auto& l = listed[i];
+            if (format == output_format::text && i == party_size) {
+                out << "box:\n";
             }
+            report_pokemon(out, format, filename, l.location, l.slot, i < party_size ? l.level : l.pokemon.level(), l.pokemon);
+        }
+        if (format == output_format::text && party_size == listed.size()) {
+            out << "box:\n";
+        }
+    } catch (const std::runtime_error& e) {
+        report_error(out, format, filename, e.what());
+    }
+    r.text = out.take();
+    return r;
+}
 
-            {
-                auto box_pokemon_data = save.get_sections_contiguous(section_type::pc_buffer_a, section_type::pc_buffer_i);
-                auto& pc_buffer_pokemon = span_cast<sections_pc_buffer>(std::span(box_pokemon_data)).front().pc_buffer_pokemon;
-                std::cout << "box:" << std::endl;
-                for (auto& pokemon: pc_buffer_pokemon) {
-                    if (pokemon.empty()) {
-                        continue;
-                    }
-                    pokemon.decode();
-                    pokemon.check();
-                    dex.set(pokemon.national_id());
-                    const auto uf = pokemon.unown_form();
-                    if (uf) {
-                        unowns.set(*uf);
-                    }
-                    std::cout << pokemon << std::endl;
+void print_report(output_buffer& out, output_format format, const dex_summary& summary) {
+    auto& dex = summary.dex;
+    auto& unowns = summary.unowns;
+    uint16_t size = gen_id_range(3).second - gen_id_range(1).first + 1;
+    if (format == output_format::jsonl) {
+        json_record record(out);
+        record.field("dex", dex.count()).field("dex_size", size);
+        for (uint8_t gen = 1; gen <= 3; gen++) {
+            size_t count = 0;
+            std::vector<std::string_view> missing;
+            for (size_t i = gen_id_range(gen).first; i <= gen_id_range(gen).second; i++) {
+                count += dex[i];
+                if (!dex[i]) {
+                    missing.push_back(species_name(i));
                 }
             }
-        } catch (const std::runtime_error& e) {
-            std::cout << "error in " << filename << ": " << e.what() << std::endl;
+            std::string gen_name = "gen" + std::to_string(gen);
+            record.field(gen_name + "_dex", count).field(gen_name + "_dex_size", gen_id_range(gen).second - gen_id_range(gen).first + 1);
+            record.strings(gen_name + "_missing", missing);
         }
+        record.field("unown", unowns.count()).field("unown_size", unowns.size());
+        return;
     }
-    std::cout << "all dex:   ";
-    uint16_t size = gen_id_range(3).second - gen_id_range(1).first + 1;
-    std::cout << dex.count() << " / " << size << " = ";
-    std::cout << 100.0f * dex.count() / size << "%" << std::endl;
+    out << "all dex:   ";
+    out << dex.count() << " / " << size << " = ";
+    out << 100.0f * dex.count() / size << "%\n";
     for (uint8_t gen = 1; gen <= 3; gen++) {
         size_t count = 0;
         for (size_t i = gen_id_range(gen).first; i <= gen_id_range(gen).second; i++) {
             count += dex[i];
         }
         uint16_t size = gen_id_range(gen).second - gen_id_range(gen).first + 1;
-        std::cout << "gen " << static_cast<int>(gen) << " dex: ";
-        std::cout << count << " / " << size << " = ";
-        std::cout << 100.0f * count / size << "%" << std::endl;
+        out << "gen " << gen << " dex: ";
+        out << count << " / " << size << " = ";
+        out << 100.0f * count / size << "%\n";
     }
     for (uint8_t gen = 1; gen <= 3; gen++) {
-        std::cout << "gen " << static_cast<int>(gen) << " missing:" << std::endl;
+        out << "gen " << gen << " missing:\n";
         for (size_t i = gen_id_range(gen).first; i <= gen_id_range(gen).second; i++) {
             if (!dex[i]) {
-                std::cout << species_name(i) << std::endl;
+                out << species_name(i) << '\n';
+            }
+        }
+    }
+    out << "unown: " << unowns.count() << " / " << unowns.size() << " = " <<
+        100.0f * unowns.count() / unowns.size() << "%\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    std::string summary_path;
+    output_format format = output_format::text;
+    bool merge = !args.empty() && args[0] == "merge";
+    std::vector<std::string> filenames;
+    try {
+        for (size_t i = merge ? 1 : 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format) || parse_stats_option(args[i])) {
+            } else if (args[i] == "--summary" && i + 1 < args.size()) {
+                summary_path = args[++i];
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                filenames.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    thread_pool pool(jobs);
+    output_buffer out;
+    std::vector<dex_summary_record> records;
+    if (merge) {
+        //pokemon-info merge [--summary out] summary-files... combines earlier runs
+        for (auto& filename: filenames) {
+            try {
+                auto r = dex_summary_file::read(filename);
+                records.insert(records.end(), std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()));
+            } catch (const std::runtime_error& e) {
+                report_error(out, format, filename, e.what());
             }
         }
+    } else {
+        //saves are read in parallel and listed in argument order
+        std::vector<file_report> reports(filenames.size());
+        for (size_t i = 0; i < filenames.size(); i++) {
+            pool.submit([&, i] {
+                reports[i] = info_file(filenames[i], format);
+            });
+        }
+        pool.wait();
+        STATS_SCOPE(output);
+        for (size_t i = 0; i < filenames.size(); i++) {
+            out << reports[i].text;
+            records.push_back({filenames[i], reports[i].summary});
+        }
+    }
+
+    if (!summary_path.empty()) {
+        try {
+            dex_summary_file::write(summary_path, records);
+        } catch (const std::runtime_error& e) {
+            out << "error: " << e.what() << '\n';
+        }
+    }
+    std::vector<dex_summary> summaries;
+    for (auto& r: records) {
+        summaries.push_back(r.summary);
+    }
+    {
+        STATS_SCOPE(output);
+        print_report(out, format, reduce_dex_summaries(summaries, pool));
+        if (!out.try_flush()) {
+            return 1;
+        }
     }
-    std::cout << "unown: " << unowns.count() << " / " << unowns.size() << " = " <<
-        100.0f * unowns.count() / unowns.size() << "%" << std::endl;
+    stats_report(format);
 }
@@ -1,7 +1,9 @@
+#pragma once
+
 #include <array>
-#include <string>
+#include <string_view>
 
-std::array<const std::string, 441> pokemon_names = {
+constexpr std::array<std::string_view, 386> pokemon_names = {
     "Bulbasaur",
     "Ivysaur",
     "Venusaur",
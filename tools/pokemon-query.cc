@@ -0,0 +1,192 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "pokemon-box-kernels.hh"
+#include "pokemon-query.hh"
+#include "thread-pool.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+struct query_counts {
+    std::atomic<size_t> entries = 0;
+    std::atomic<size_t> decoded = 0;
+    std::atomic<size_t> matches = 0;
+};
+
+std::string format_field(query_field field, const query_entry& e, const std::vector<std::string>& filenames) {
+    int64_t v = query_value(field, e);
+    switch (field) {
+        case query_field::file:
+            return filenames[e.file];
+        case query_field::location:
+            return e.party ? "party" : "box";
+        case query_field::species:
+            return std::string(species_name(v));
+        case query_field::unown:
+            return v < 0 ? "-" : std::string(1, unown_letters[v]);
+        default:
+            return std::to_string(v);
+    }
+}
+
+//the matching rows of one file, one line each with the selected fields separated by tabs or one
+//json record each with numbers kept as numbers
+std::string query_save(size_t file_index, const std::vector<std::string>& filenames, const query& q, const std::vector<query_field>& select, output_format format, query_counts& counts) {
+    auto m = mmap_file(filenames[file_index], mmap_mode::read_only);
+    auto d = save_payload(m.data);
+    auto& f = span_cast<pokemon_gen3_format>(d).front();
+    auto& save = f.check();
+
+    output_buffer out(-1);
+    size_t entries = 0, decoded_count = 0, matches = 0;
+    auto consider = [&](query_entry e) {
+        entries++;
+        if (!q.prefilter(e)) {
+            return;
+        }
+        pokemon_box decoded;
+        e.valid = decode_and_check(*e.encrypted, decoded);
+        e.decoded = &decoded;
+        decoded_count++;
+        if (!q.filter(e)) {
+            return;
+        }
+        matches++;
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            for (auto field: select) {
+                auto name = query_field_info_of(field).name;
+                if (field == query_field::file || field == query_field::location || field == query_field::species || field == query_field::unown) {
+                    record.field(name, format_field(field, e, filenames));
+                } else {
+                    record.field(name, query_value(field, e));
+                }
+            }
+            return;
+        }
+        for (size_t i = 0; i < select.size(); i++) {
+            out << format_field(select[i], e, filenames) << (i + 1 < select.size() ? '\t' : '\n');
+        }
+    };
+
+    auto team_items_section = static_cast<section_team_items&>(save.get_section_by_id(section_type::team_items));
+    auto party = team_items_section.get_pokemon_party(f.game_version(save));
+    for (size_t i = 0; i < party.size(); i++) {
+        consider({file_index, &party[i], nullptr, true, 0xff, static_cast<uint8_t>(i), false});
+    }
+    pc_buffer_view(save).for_each([&](const pokemon_box& encrypted, size_t i) {
+        if (encrypted.empty()) {
+            return;
+        }
+        consider({file_index, &encrypted, nullptr, false, static_cast<uint8_t>(i / pc_buffer_view::slots_per_box), static_cast<uint8_t>(i % pc_buffer_view::slots_per_box), false});
+    });
+    counts.entries += entries;
+    counts.decoded += decoded_count;
+    counts.matches += matches;
+    return out.take();
+}
+
+std::vector<query_field> parse_select(std::string_view list) {
+    std::vector<query_field> fields;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        fields.push_back(query_field_by_name(list.substr(0, comma)).field);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return fields;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    std::string select_list = "file,location,box,slot,level,species";
+    std::optional<std::string> filter;
+    output_format format = output_format::text;
+    std::vector<std::string> paths;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if (args[i] == "--select" && i + 1 < args.size()) {
+                select_list = args[++i];
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else if (!filter) {
+                filter = args[i];
+            } else {
+                paths.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    output_buffer out;
+    if (!filter || paths.empty()) {
+        out << "usage: pokemon-query [--jobs N] [--format=text|jsonl] [--select field,...] 'filter' save_file_or_directory...\n";
+        out << "fields:";
+        for (auto& f: query_fields) {
+            out << " " << f.name;
+        }
+        out << '\n';
+        return 1;
+    }
+
+    std::vector<std::string> filenames;
+    std::vector<query_field> select;
+    std::optional<query> q;
+    try {
+        q.emplace(*filter);
+        select = parse_select(select_list);
+        filenames = collect_save_files(paths);
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+
+    //files are queried in parallel and their output printed in argument order
+    std::vector<std::string> outputs(filenames.size());
+    std::vector<std::string> errors(filenames.size());
+    query_counts counts;
+    {
+        thread_pool pool(jobs);
+        for (size_t i = 0; i < filenames.size(); i++) {
+            pool.submit([&, i] {
+                try {
+                    outputs[i] = query_save(i, filenames, *q, select, format, counts);
+                } catch (const std::runtime_error& e) {
+                    errors[i] = e.what();
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    size_t error_count = 0;
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (!errors[i].empty()) {
+            report_error(out, format, filenames[i], errors[i]);
+            error_count++;
+        }
+        out << outputs[i];
+    }
+    if (format == output_format::jsonl) {
+        json_record(out).field("matches", counts.matches.load()).field("files", filenames.size())
+            .field("decoded", counts.decoded.load()).field("pokemon", counts.entries.load()).field("errors", error_count);
+    } else {
+        out << counts.matches.load() << " matches in " << filenames.size() << " files, "
+            << counts.decoded.load() << " of " << counts.entries.load() << " pokemon decoded, "
+            << error_count << " errors\n";
+    }
+    if (!out.try_flush()) {
+        return 1;
+    }
+    return error_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cctype>
+#include <algorithm>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <stdexcept>
+
+#include "pokemon-gen3-format.hh"
+
+//a small filter language over party and box pokemon, e.g.
+//  shiny && level > 50 && !party
+//  species == Unown && unown == F
+//  (legendary || mythical) && iv_total >= 150
+//comparisons are == != < <= > >=, combined with && || ! and parentheses, a bare field is true
+//when it is non-zero. species takes a name or a national id, unown a letter, ! or ?
+enum class query_field {
+    file,
+    location,
+    party,
+    box,
+    slot,
+    personality,
+    original_trainer_id,
+    shiny,
+    valid,
+    species,
+    level,
+    experience,
+    gen,
+    legendary,
+    mythical,
+    starter,
+    unown,
+    iv_hp,
+    iv_attack,
+    iv_defense,
+    iv_speed,
+    iv_sp_attack,
+    iv_sp_defense,
+    iv_total,
+};
+
+struct query_field_info {
+    std::string_view name;
+    query_field field;
+    //false for fields readable from the still encrypted entry, predicates on those run first
+    bool needs_decode;
+};
+
+constexpr std::array<query_field_info, 24> query_fields = {{
+    {"file", query_field::file, false},
+    {"location", query_field::location, false},
+    {"party", query_field::party, false},
+    {"box", query_field::box, false},
+    {"slot", query_field::slot, false},
+    {"personality", query_field::personality, false},
+    {"original_trainer_id", query_field::original_trainer_id, false},
+    {"shiny", query_field::shiny, false},
+    {"valid", query_field::valid, true},
+    {"species", query_field::species, true},
+    {"level", query_field::level, true},
+    {"experience", query_field::experience, true},
+    {"gen", query_field::gen, true},
+    {"legendary", query_field::legendary, true},
+    {"mythical", query_field::mythical, true},
+    {"starter", query_field::starter, true},
+    {"unown", query_field::unown, true},
+    {"iv_hp", query_field::iv_hp, true},
+    {"iv_attack", query_field::iv_attack, true},
+    {"iv_defense", query_field::iv_defense, true},
+    {"iv_speed", query_field::iv_speed, true},
+    {"iv_sp_attack", query_field::iv_sp_attack, true},
+    {"iv_sp_defense", query_field::iv_sp_defense, true},
+    {"iv_total", query_field::iv_total, true},
+}};
+
+const query_field_info& query_field_by_name(std::string_view name) {
+    for (auto& f: query_fields) {
+        if (f.name == name) {
+            return f;
+        }
+    }
+    if (name == "pid") {
+        return query_field_by_name("personality");
+    } else if (name == "otid") {
+        return query_field_by_name("original_trainer_id");
+    } else if (name == "exp") {
+        return query_field_by_name("experience");
+    }
+    throw std::runtime_error("query: unknown field " + std::string(name));
+}
+
+const query_field_info& query_field_info_of(query_field field) {
+    return query_fields[static_cast<size_t>(field)];
+}
+
+//one party or box entry, decoded stays null until every predicate that doesn't need it has passed
+struct query_entry {
+    size_t file;
+    const pokemon_box* encrypted;
+    const pokemon_box* decoded;
+    bool party;
+    uint8_t box;
+    uint8_t slot;
+    bool valid;
+};
+
+int64_t query_value(query_field field, const query_entry& e) {
+    const pokemon_box& p = e.decoded ? *e.decoded : *e.encrypted;
+    auto iv = [&](size_t i) { return static_cast<int64_t>(p.ivs()[i]); };
+    switch (field) {
+        case query_field::file:
+            return e.file;
+        case query_field::location:
+        case query_field::party:
+            return e.party;
+        case query_field::box:
+            return e.box;
+        case query_field::slot:
+            return e.slot;
+        case query_field::personality:
+            return p.personality;
+        case query_field::original_trainer_id:
+            return p.original_trainer_id;
+        case query_field::shiny:
+            return p.shiny();
+        case query_field::valid:
+            return e.valid;
+        case query_field::species:
+            return p.national_id();
+        case query_field::level:
+            return p.level();
+        case query_field::experience:
+            return p.growth.experience;
+        case query_field::gen:
+            return species_table::size > p.national_id() ? gen(p.national_id()) : 0;
+        case query_field::legendary:
+            return p.legendary();
+        case query_field::mythical:
+            return p.mythical();
+        case query_field::starter:
+            return p.starter();
+        case query_field::unown:
+            return p.unown_form().value_or(-1);
+        case query_field::iv_hp:
+            return iv(0);
+        case query_field::iv_attack:
+            return iv(1);
+        case query_field::iv_defense:
+            return iv(2);
+        case query_field::iv_speed:
+            return iv(3);
+        case query_field::iv_sp_attack:
+            return iv(4);
+        case query_field::iv_sp_defense:
+            return iv(5);
+        case query_field::iv_total: {
+            auto ivs = p.ivs();
+            return ivs[0] + ivs[1] + ivs[2] + ivs[3] + ivs[4] + ivs[5];
+        }
+    }
+    return 0;
+}
+
+enum class query_op {
+    eq,
+    ne,
+    lt,
+    le,
+    gt,
+    ge,
+};
+
+struct query_node {
+    enum class kind {
+        compare,
+        truthy,
+        not_,
+        and_,
+        or_,
+    };
+
+    kind k;
+    query_field field = query_field::file;
+    query_op op = query_op::eq;
+    int64_t value = 0;
+    std::unique_ptr<query_node> lhs;
+    std::unique_ptr<query_node> rhs;
+
+    bool needs_decode() const {
+        switch (k) {
+            case kind::compare:
+            case kind::truthy:
+                return query_field_info_of(field).needs_decode;
+            case kind::not_:
+                return lhs->needs_decode();
+            case kind::and_:
+            case kind::or_:
+                return lhs->needs_decode() || rhs->needs_decode();
+        }
+        return true;
+    }
+
+    bool eval(const query_entry& e) const {
+        switch (k) {
+            case kind::compare: {
+                int64_t v = query_value(field, e);
+                switch (op) {
+                    case query_op::eq: return v == value;
+                    case query_op::ne: return v != value;
+                    case query_op::lt: return v < value;
+                    case query_op::le: return v <= value;
+                    case query_op::gt: return v > value;
+                    case query_op::ge: return v >= value;
+                }
+                return false;
+            }
+            case kind::truthy:
+                return query_value(field, e) != 0;
+            case kind::not_:
+                return !lhs->eval(e);
+            case kind::and_:
+                return lhs->eval(e) && rhs->eval(e);
+            case kind::or_:
+                return lhs->eval(e) || rhs->eval(e);
+        }
+        return false;
+    }
+};
+
+//recursive descent over the filter text, throws std::runtime_error on anything it doesn't understand
+struct query_parser {
+    std::string_view text;
+    size_t pos = 0;
+
+    static bool word_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '\'' || c == '-' || static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    void skip_space() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    bool accept(std::string_view token) {
+        skip_space();
+        if (text.substr(pos, token.size()) == token) {
+            //keywords must not run into the next word
+            if (word_char(token.back()) && pos + token.size() < text.size() && word_char(text[pos + token.size()])) {
+                return false;
+            }
+            pos += token.size();
+            return true;
+        }
+        return false;
+    }
+
+    [[noreturn]] void fail(const std::string& what) {
+        throw std::runtime_error("query: " + what + " at column " + std::to_string(pos + 1) + " of \"" + std::string(text) + "\"");
+    }
+
+    std::string_view word() {
+        skip_space();
+        if (pos < text.size() && text[pos] == '"') {
+            size_t end = text.find('"', pos + 1);
+            if (end == std::string_view::npos) {
+                fail("unterminated string");
+            }
+            auto w = text.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+            return w;
+        }
+        size_t start = pos;
+        while (pos < text.size() && word_char(text[pos])) {
+            pos++;
+        }
+        if (start == pos) {
+            fail("expected a field or value");
+        }
+        return text.substr(start, pos - start);
+    }
+
+    int64_t value_for(query_field field, std::string_view w) {
+        int64_t v = 0;
+        bool hex = w.starts_with("0x");
+        auto digits = hex ? w.substr(2) : w;
+        auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), v, hex ? 16 : 10);
+        if (!digits.empty() && ec == std::errc() && end == digits.data() + digits.size()) {
+            return v;
+        }
+        if (field == query_field::species) {
+            for (uint16_t n = 1; n < species_table::size; n++) {
+                auto name = species_name(n);
+                if (name.size() == w.size() && std::equal(name.begin(), name.end(), w.begin(), [](char a, char b) {
+                    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+                })) {
+                    return n;
+                }
+            }
+            fail("unknown species " + std::string(w));
+        }
+        if (field == query_field::unown && w.size() == 1) {
+            size_t letter = unown_letters.find(std::toupper(static_cast<unsigned char>(w[0])));
+            if (letter != std::string_view::npos) {
+                return letter;
+            }
+        }
+        if (field == query_field::location && (w == "party" || w == "box")) {
+            return w == "party";
+        }
+        fail("bad value " + std::string(w));
+    }
+
+    std::unique_ptr<query_node> binary(query_node::kind k, std::unique_ptr<query_node> lhs, std::unique_ptr<query_node> rhs) {
+        auto n = std::make_unique<query_node>();
+        n->k = k;
+        n->lhs = std::move(lhs);
+        n->rhs = std::move(rhs);
+        return n;
+    }
+
+    std::unique_ptr<query_node> parse_or() {
+        auto lhs = parse_and();
+        while (accept("||") || accept("or")) {
+            lhs = binary(query_node::kind::or_, std::move(lhs), parse_and());
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<query_node> parse_and() {
+        auto lhs = parse_not();
+        while (accept("&&") || accept("and")) {
+            lhs = binary(query_node::kind::and_, std::move(lhs), parse_not());
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<query_node> parse_not() {
+        if (accept("!=")) {
+            fail("expected a field");
+        }
+        if (accept("!") || accept("not")) {
+            auto n = std::make_unique<query_node>();
+            n->k = query_node::kind::not_;
+            n->lhs = parse_not();
+            return n;
+        }
+        return parse_primary();
+    }
+
+    std::unique_ptr<query_node> parse_primary() {
+        if (accept("(")) {
+            auto n = parse_or();
+            if (!accept(")")) {
+                fail("expected )");
+            }
+            return n;
+        }
+        auto n = std::make_unique<query_node>();
+        n->field = query_field_by_name(word()).field;
+        constexpr std::array<std::pair<std::string_view, query_op>, 6> ops = {{
+            {"==", query_op::eq}, {"!=", query_op::ne}, {"<=", query_op::le},
+            {">=", query_op::ge}, {"<", query_op::lt}, {">", query_op::gt},
+        }};
+        for (auto& [token, op]: ops) {
+            if (accept(token)) {
+                n->k = query_node::kind::compare;
+                n->op = op;
+                n->value = value_for(n->field, word());
+                return n;
+            }
+        }
+        n->k = query_node::kind::truthy;
+        return n;
+    }
+
+    std::unique_ptr<query_node> parse() {
+        auto n = parse_or();
+        skip_space();
+        if (pos != text.size()) {
+            fail("unexpected text");
+        }
+        return n;
+    }
+};
+
+//a parsed filter with its top level && split in two: conjuncts on fields of the encrypted entry
+//(personality, ot id, location, shiny) are tried before the entry is decoded at all
+struct query {
+    std::unique_ptr<query_node> root;
+    std::vector<const query_node*> before_decode;
+    std::vector<const query_node*> after_decode;
+
+    explicit query(std::string_view text) {
+        if (text.find_first_not_of(" \t\n") == std::string_view::npos) {
+            return;
+        }
+        root = query_parser{text}.parse();
+        split(root.get());
+    }
+
+    void split(const query_node* n) {
+        if (n->k == query_node::kind::and_) {
+            split(n->lhs.get());
+            split(n->rhs.get());
+        } else if (n->needs_decode()) {
+            after_decode.push_back(n);
+        } else {
+            before_decode.push_back(n);
+        }
+    }
+
+    bool prefilter(const query_entry& e) const {
+        for (auto n: before_decode) {
+            if (!n->eval(e)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool filter(const query_entry& e) const {
+        for (auto n: after_decode) {
+            if (!n->eval(e)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -1,11 +1,14 @@
+#pragma once
+
 #include <string>
 #include <array>
+#include <span>
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
-#include <cuchar>
-#include <climits>
+#include <stdexcept>
 
-std::array<char32_t, 273> pokemon_char_to_char = {
+constexpr std::array<char32_t, 273> pokemon_char_to_char = {
     U"                "
     U"                "
     U"                "
@@ -24,25 +27,122 @@ std::array<char32_t, 273> pokemon_char_to_char = {
     U" ÄÖÜäöü         "
 };
 
-template<typename S>
-std::string pokemon_string_to_string(S p_str) {
-    std::u32string s32;
-    for (unsigned char p_c: p_str) {
-        s32.push_back(pokemon_char_to_char[p_c]);
+//ends every gen 3 string shorter than its field
+constexpr uint8_t pokemon_string_terminator = 0xff;
+constexpr uint8_t pokemon_char_space = 0x00;
+
+//everything in the charset is in the basic multilingual plane
+constexpr size_t pokemon_char_utf8_max = 3;
+
+struct pokemon_char_utf8 {
+    std::array<char, pokemon_char_utf8_max> bytes;
+    uint8_t size;
+};
+
+constexpr pokemon_char_utf8 encode_utf8(char32_t c) {
+    if (c < 0x80) {
+        return {{static_cast<char>(c)}, 1};
+    } else if (c < 0x800) {
+        return {{static_cast<char>(0xc0 | (c >> 6)), static_cast<char>(0x80 | (c & 0x3f))}, 2};
     }
+    return {{
+        static_cast<char>(0xe0 | (c >> 12)),
+        static_cast<char>(0x80 | ((c >> 6) & 0x3f)),
+        static_cast<char>(0x80 | (c & 0x3f)),
+    }, 3};
+}
 
-    std::string s;
-    std::setlocale(LC_ALL, "en_US.utf8");
-    std::mbstate_t state{};
-    char out[MB_LEN_MAX]{};
-    for (char32_t c: s32) {
-        std::size_t rc = std::c32rtomb(out, c, &state);
-        if (rc != (std::size_t) - 1) {
-            for (unsigned char c8: std::string_view{out, rc}) {
-                s.push_back(c8);
-            }
+constexpr std::array<pokemon_char_utf8, 256> make_pokemon_char_utf8_table() {
+    std::array<pokemon_char_utf8, 256> table{};
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = encode_utf8(pokemon_char_to_char[i]);
+    }
+    return table;
+}
+
+constexpr std::array<pokemon_char_utf8, 256> pokemon_char_utf8_table = make_pokemon_char_utf8_table();
+
+//ascii back to the charset, pokemon_string_terminator where there is no such character
+constexpr std::array<uint8_t, 128> make_ascii_to_pokemon_char() {
+    std::array<uint8_t, 128> table{};
+    table.fill(pokemon_string_terminator);
+    //the unused slots also show up as spaces, 0x00 is the one the games write
+    for (size_t i = pokemon_char_space + 1; i < 256; i++) {
+        char32_t c = pokemon_char_to_char[i];
+        if (c < table.size() && table[c] == pokemon_string_terminator) {
+            table[c] = i;
+        }
+    }
+    table[' '] = pokemon_char_space;
+    return table;
+}
+
+constexpr std::array<uint8_t, 128> ascii_to_pokemon_char = make_ascii_to_pokemon_char();
+
+static_assert(pokemon_char_utf8_table[0xbb].size == 1 && pokemon_char_utf8_table[0xbb].bytes[0] == 'A');
+static_assert(pokemon_char_utf8_table[0xb5].size == 3);
+static_assert(ascii_to_pokemon_char['a'] == 0xd5);
+
+//transcodes p_str up to its terminator into out and returns the number of bytes written, stops
+//early rather than split a character when out is too small. no locale, no allocation, and only
+//constant tables, so it is safe to call from any thread
+size_t pokemon_string_to_utf8(std::span<const char> p_str, std::span<char> out) {
+    size_t n = 0;
+    for (char p_c: p_str) {
+        uint8_t c = static_cast<uint8_t>(p_c);
+        if (c == pokemon_string_terminator) {
+            break;
+        }
+        const auto& u = pokemon_char_utf8_table[c];
+        if (n + u.size > out.size()) {
+            break;
         }
+        for (size_t i = 0; i < u.size; i++) {
+            out[n + i] = u.bytes[i];
+        }
+        n += u.size;
     }
+    return n;
+}
 
+template<typename S>
+std::string pokemon_string_to_string(const S& p_str) {
+    std::string s(std::size(p_str) * pokemon_char_utf8_max, '\0');
+    s.resize(pokemon_string_to_utf8(std::span<const char>(reinterpret_cast<const char*>(std::data(p_str)), std::size(p_str)), s));
     return s;
 }
+
+//the reverse, for editing: encodes utf-8 into out and pads the rest with the terminator, throws if a
+//character has no gen 3 equivalent or the string doesn't fit
+void string_to_pokemon_string(std::string_view s, std::span<char> out) {
+    size_t n = 0;
+    for (size_t i = 0; i < s.size();) {
+        uint8_t lead = static_cast<uint8_t>(s[i]);
+        uint8_t c = pokemon_string_terminator;
+        size_t len = 1;
+        if (lead < 0x80) {
+            c = ascii_to_pokemon_char[lead];
+        } else {
+            len = lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 0;
+            //non-ascii characters are rare in names, so a scan of the table is fine
+            for (size_t j = 0; len != 0 && j < pokemon_char_utf8_table.size(); j++) {
+                const auto& u = pokemon_char_utf8_table[j];
+                if (u.size == len && s.substr(i, len) == std::string_view(u.bytes.data(), u.size)) {
+                    c = j;
+                    break;
+                }
+            }
+        }
+        if (c == pokemon_string_terminator) {
+            throw std::runtime_error("no gen 3 character for \"" + std::string(s.substr(i, len ? len : 1)) + "\" in \"" + std::string(s) + "\"");
+        }
+        if (n == out.size()) {
+            throw std::runtime_error("\"" + std::string(s) + "\" is longer than " + std::to_string(out.size()) + " characters");
+        }
+        out[n++] = static_cast<char>(c);
+        i += len;
+    }
+    for (; n < out.size(); n++) {
+        out[n] = static_cast<char>(pokemon_string_terminator);
+    }
+}
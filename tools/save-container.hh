@@ -0,0 +1,121 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "pokemon-gen3-format.hh"
+
+//how an emulator stored the 128KiB of flash around it
+enum class save_container_kind {
+    //exactly the flash, as lemuroid (.srm) and most emulators write it
+    raw,
+    //the flash followed by the cartridge clock, as mgba (.sav) writes it for rtc games
+    rtc,
+    //the flash followed by unused 0x00 or 0xff bytes, from dumpers and emulators that round the
+    //file up to a larger flash size
+    padded,
+};
+
+constexpr std::array<std::string_view, 3> save_container_kind_names = {
+    "raw",
+    "rtc",
+    "padded",
+};
+
+//mgba's footer, the s-3511 clock registers as bcd and the host time they were last latched at.
+//some versions pad the footer to 32 bytes, the rest is kept but not interpreted
+struct gba_rtc_footer {
+    //year, month, day, day of week, hour, minute, second
+    std::array<uint8_t, 7> time;
+    uint8_t control;
+    uint64_t last_latch;
+};
+static_assert(sizeof(gba_rtc_footer) == 16);
+
+struct gba_rtc {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t day_of_week;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t control;
+    //unix time of the host when the clock was last read by the game
+    uint64_t last_latch;
+
+    static gba_rtc parse(const gba_rtc_footer& footer) {
+        auto bcd = [](uint8_t b) {
+            return static_cast<uint8_t>((b >> 4) * 10 + (b & 0x0f));
+        };
+        return {
+            static_cast<uint16_t>(2000 + bcd(footer.time[0])),
+            bcd(footer.time[1]),
+            bcd(footer.time[2]),
+            bcd(footer.time[3]),
+            //bit 6 of the hour is the pm flag, which the game only uses in 12 hour mode
+            bcd(footer.time[4] & 0x3f),
+            bcd(footer.time[5]),
+            bcd(footer.time[6]),
+            footer.control,
+            footer.last_latch,
+        };
+    }
+
+    //yyyy-mm-dd hh:mm:ss
+    std::string to_string() const {
+        std::array<char, 32> s;
+        std::snprintf(s.data(), s.size(), "%04u-%02u-%02u %02u:%02u:%02u", year, month, day, hour, minute, second);
+        return s.data();
+    }
+};
+
+//a save file split into the flash and whatever follows it, both views into the caller's buffer
+struct save_container {
+    save_container_kind kind;
+    std::span<std::byte> payload;
+    std::span<std::byte> footer;
+    std::optional<gba_rtc> rtc;
+};
+
+constexpr std::array<size_t, 2> rtc_footer_sizes = {16, 32};
+
+//recognises the container by its size and what follows the flash, without copying anything
+save_container open_save_container(std::span<std::byte> d) {
+    constexpr size_t payload_size = sizeof(pokemon_gen3_format);
+    if (d.size() < payload_size) {
+        throw std::runtime_error("wrong save file size");
+    }
+    save_container c{save_container_kind::raw, d.first(payload_size), d.subspan(payload_size), std::nullopt};
+    if (c.footer.empty()) {
+        return c;
+    }
+    if (std::find(rtc_footer_sizes.begin(), rtc_footer_sizes.end(), c.footer.size()) != rtc_footer_sizes.end()) {
+        gba_rtc_footer footer;
+        std::memcpy(&footer, c.footer.data(), sizeof(footer));
+        c.kind = save_container_kind::rtc;
+        c.rtc = gba_rtc::parse(footer);
+        return c;
+    }
+    for (auto fill: {std::byte{0x00}, std::byte{0xff}}) {
+        if (std::all_of(c.footer.begin(), c.footer.end(), [fill](std::byte b) { return b == fill; })) {
+            c.kind = save_container_kind::padded;
+            return c;
+        }
+    }
+    throw std::runtime_error("wrong save file size");
+}
+
+//the 128KiB the game sees, for tools that don't care how the emulator stored it
+std::span<std::byte> save_payload(std::span<std::byte> d) {
+    return open_save_container(d).payload;
+}
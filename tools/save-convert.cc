@@ -0,0 +1,239 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <cstdio>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "thread-pool.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+//what a converted save is written as
+enum class convert_target {
+    //the flash alone as .srm, for lemuroid
+    raw,
+    //the flash as .sav, with the rtc footer of the source if it had one, for mgba
+    mgba,
+};
+
+struct convert_job {
+    std::string input;
+    //where the output goes below the output directory, the input's path below the directory
+    //argument it was found in
+    std::filesystem::path relative;
+    //set when another input would be written to the same output, neither of them is converted
+    std::string error;
+};
+
+struct convert_result {
+    std::string output;
+    save_container_kind kind = save_container_kind::raw;
+    size_t footer_size = 0;
+    std::optional<gba_rtc> rtc;
+    std::string error;
+};
+
+void write_all(int fd, const std::byte* p, size_t size, off_t offset, const std::string& filename) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+//the payload goes from the input file to the output file inside the kernel where the filesystems
+//allow it, and straight from the input mapping otherwise, never through a buffer of our own
+void copy_payload(const mmap_file& in, std::span<const std::byte> payload, int out_fd, const std::string& filename) {
+    loff_t in_offset = 0, out_offset = 0;
+    while (static_cast<size_t>(out_offset) < payload.size()) {
+        ssize_t n = copy_file_range(in.fd, &in_offset, out_fd, &out_offset, payload.size() - out_offset, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            //cross-device on older kernels, or a filesystem without support
+            break;
+        }
+    }
+    write_all(out_fd, payload.data() + out_offset, payload.size() - out_offset, out_offset, filename);
+}
+
+convert_result convert_save(const convert_job& job, const std::filesystem::path& output_directory, convert_target target) {
+    convert_result r;
+    try {
+        auto m = mmap_file(job.input, mmap_mode::read_only);
+        auto c = open_save_container(m.data);
+        r.kind = c.kind;
+        r.footer_size = c.footer.size();
+        r.rtc = c.rtc;
+        span_cast<pokemon_gen3_format>(c.payload).front().check();
+
+        auto path = output_directory / job.relative;
+        path.replace_extension(target == convert_target::raw ? ".srm" : ".sav");
+        r.output = path.string();
+        if (path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path());
+        }
+        //written next to the output and renamed over it, so nothing ever sees half a save
+        auto temporary = r.output + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(temporary + ": " + strerror(errno));
+        }
+        try {
+            copy_payload(m, c.payload, fd, temporary);
+            if (target == convert_target::mgba && c.kind == save_container_kind::rtc) {
+                write_all(fd, c.footer.data(), c.footer.size(), c.payload.size(), temporary);
+            }
+        } catch (...) {
+            close(fd);
+            unlink(temporary.c_str());
+            throw;
+        }
+        close(fd);
+        if (rename(temporary.c_str(), r.output.c_str()) < 0) {
+            unlink(temporary.c_str());
+            throw std::runtime_error(r.output + ": " + strerror(errno));
+        }
+    } catch (const std::runtime_error& e) {
+        r.error = e.what();
+    }
+    return r;
+}
+
+std::vector<convert_job> collect_convert_jobs(const std::vector<std::string>& paths) {
+    std::vector<convert_job> jobs;
+    for (auto& path: paths) {
+        if (!std::filesystem::is_directory(path)) {
+            jobs.push_back({path, std::filesystem::path(path).filename(), {}});
+            continue;
+        }
+        for (auto& filename: collect_save_files({path})) {
+            jobs.push_back({filename, std::filesystem::relative(filename, path), {}});
+        }
+    }
+    //X.srm and X.sav in one directory, or the same name below two arguments, end up as one output
+    std::unordered_map<std::string, size_t> outputs;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        auto output = jobs[i].relative;
+        output.replace_extension();
+        auto [it, inserted] = outputs.emplace(output.lexically_normal().string(), i);
+        if (!inserted) {
+            auto& first = jobs[it->second];
+            jobs[i].error = "same output as " + first.input;
+            if (first.error.empty()) {
+                first.error = "same output as " + jobs[i].input;
+            }
+        }
+    }
+    return jobs;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t threads = std::thread::hardware_concurrency();
+    output_format format = output_format::text;
+    convert_target target = convert_target::raw;
+    std::string output_directory;
+    std::vector<std::string> paths;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if (args[i] == "--to" && i + 1 < args.size()) {
+                auto to = args[++i];
+                if (to == "raw" || to == "srm") {
+                    target = convert_target::raw;
+                } else if (to == "mgba" || to == "sav") {
+                    target = convert_target::mgba;
+                } else {
+                    std::cout << "error: unknown target " << to << ", expected raw or mgba" << std::endl;
+                    return 1;
+                }
+            } else if ((args[i] == "--output" || args[i] == "-o") && i + 1 < args.size()) {
+                output_directory = args[++i];
+            } else if (parse_jobs_option(args, i, threads)) {
+            } else {
+                paths.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    output_buffer out;
+    if (output_directory.empty() || paths.empty()) {
+        out << "usage: save-convert [--to raw|mgba] [--jobs N] [--format=text|jsonl] -o directory files-or-directories...\n";
+        return 1;
+    }
+
+    std::vector<convert_job> jobs;
+    try {
+        jobs = collect_convert_jobs(paths);
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+    std::vector<convert_result> results(jobs.size());
+    {
+        thread_pool pool(threads);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (!jobs[i].error.empty()) {
+                results[i].error = jobs[i].error;
+                continue;
+            }
+            pool.submit([&, i] {
+                results[i] = convert_save(jobs[i], output_directory, target);
+            });
+        }
+        pool.wait();
+    }
+
+    size_t errors = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        auto& r = results[i];
+        if (!r.error.empty()) {
+            errors++;
+            report_error(out, format, jobs[i].input, r.error);
+            continue;
+        }
+        auto kind = save_container_kind_names[static_cast<size_t>(r.kind)];
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            record.field("file", jobs[i].input).field("output", r.output).field("container", kind).field("footer_bytes", r.footer_size);
+            if (r.rtc) {
+                record.field("rtc", r.rtc->to_string()).field("rtc_control", r.rtc->control).field("rtc_last_latch", r.rtc->last_latch);
+            }
+            continue;
+        }
+        out << "converted " << jobs[i].input << " (" << kind;
+        if (r.rtc) {
+            out << ", clock " << r.rtc->to_string();
+        }
+        out << ") to " << r.output << '\n';
+    }
+    if (format == output_format::jsonl) {
+        json_record(out).field("files", jobs.size()).field("converted", jobs.size() - errors).field("errors", errors);
+    } else {
+        out << jobs.size() << " files, " << jobs.size() - errors << " converted, " << errors << " errors\n";
+    }
+    if (!out.try_flush()) {
+        return 1;
+    }
+    return errors == 0 ? 0 : 1;
+}
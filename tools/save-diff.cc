@@ -0,0 +1,171 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "save-diff.hh"
+#include "output.hh"
+
+void report_pokemon_change(output_buffer& out, output_format format, const pokemon_change& c) {
+    auto kind = pokemon_change_kind_names[static_cast<size_t>(c.kind)];
+    auto& p = c.after ? *c.after : *c.before;
+    if (format == output_format::jsonl) {
+        json_record record(out);
+        record.field("change", "pokemon").field("kind", kind).field("species", p.decoded.species_name())
+            .field("personality", p.decoded.personality).field("original_trainer_id", p.decoded.original_trainer_id);
+        if (c.before) {
+            record.field("from", c.before->where.to_string());
+        }
+        if (c.after) {
+            record.field("to", c.after->where.to_string());
+        }
+        record.strings("details", c.details);
+        return;
+    }
+    out << kind << ' ' << p.decoded.species_name() << " (" << p.decoded.nickname_str() << ')';
+    if (c.kind == pokemon_change_kind::moved) {
+        out << " from " << c.before->where.to_string() << " to " << c.after->where.to_string();
+    } else {
+        out << (c.after ? " in " : " from ") << p.where.to_string();
+    }
+    for (size_t i = 0; i < c.details.size(); i++) {
+        out << (i == 0 ? ": " : ", ") << c.details[i];
+    }
+    out << '\n';
+}
+
+int diff(output_buffer& out, output_format format, const std::string& filename_a, const std::string& filename_b, const std::string& patch_path) {
+    auto ma = mmap_file(filename_a, mmap_mode::read_only);
+    auto mb = mmap_file(filename_b, mmap_mode::read_only);
+    auto& fa = span_cast<pokemon_gen3_format>(save_payload(ma.data)).front();
+    auto& fb = span_cast<pokemon_gen3_format>(save_payload(mb.data)).front();
+    auto& a = fa.check();
+    auto& b = fb.check();
+    auto gv = fb.game_version(b);
+    if (fa.game_version(a) != gv) {
+        throw std::runtime_error("the saves are from different games, " + game_version_string(fa.game_version(a)) + " and " + game_version_string(gv));
+    }
+
+    auto diffs = diff_saves(a, b);
+    size_t changed_sections = 0;
+    for (auto& d: diffs) {
+        changed_sections += !d.identical;
+        size_t bytes = 0;
+        for (auto& r: d.ranges) {
+            bytes += r.length;
+        }
+        if (format == output_format::jsonl) {
+            json_record(out).field("change", "section").field("section", section_names[d.id]).field("identical", d.identical)
+                .field("ranges", d.ranges.size()).field("bytes", bytes);
+        } else if (!d.identical) {
+            out << "section " << section_names[d.id] << ": " << bytes << " bytes changed in " << d.ranges.size() << " ranges\n";
+        }
+    }
+
+    auto changes = diff_pokemon(collect_pokemon(fa, a), collect_pokemon(fb, b));
+    for (auto& c: changes) {
+        report_pokemon_change(out, format, c);
+    }
+
+    auto flags = diff_flags(a, b, gv);
+    for (auto& f: flags) {
+        if (format == output_format::jsonl) {
+            json_record(out).field("change", "flag").field("flag", f.flag).field("set", f.set);
+        } else {
+            std::array<char, 8> hex;
+            std::snprintf(hex.data(), hex.size(), "0x%03x", f.flag);
+            out << "flag " << hex.data() << (f.set ? " set\n" : " cleared\n");
+        }
+    }
+
+    auto card_a = wonder_card(fa, a);
+    auto card_b = wonder_card(fb, b);
+    if (card_a || card_b) {
+        std::string_view what = !card_a ? "installed" : !card_b ? "removed" : "changed";
+        bool same = card_a && card_b && std::memcmp(&*card_a, &*card_b, sizeof(*card_a)) == 0;
+        if (!same) {
+            auto& card = card_b ? *card_b : *card_a;
+            auto title = pokemon_string_to_string(card.title);
+            if (format == output_format::jsonl) {
+                json_record(out).field("change", "gift").field("kind", what).field("event_id", card.event_id).field("title", title);
+            } else {
+                out << "gift " << what << ": " << title << " (event " << card.event_id << ")\n";
+            }
+        }
+    }
+
+    auto patch = save_patch::from_diff(diffs, b, gv);
+    if (!patch_path.empty()) {
+        patch.write(patch_path);
+    }
+    if (format == output_format::jsonl) {
+        json_record(out).field("sections_changed", changed_sections).field("pokemon_changes", changes.size())
+            .field("flags_toggled", flags.size()).field("patch_records", patch.records.size()).field("patch_bytes", patch.bytes());
+    } else {
+        out << changed_sections << " sections changed, " << changes.size() << " pokemon changes, " << flags.size()
+            << " flags toggled, patch of " << patch.records.size() << " ranges, " << patch.bytes() << " bytes\n";
+    }
+    out.flush();
+    return 0;
+}
+
+//like gift-tool the patched data goes into a new save in the other slot, so a failed write leaves
+//the current save as it was
+int apply(output_buffer& out, output_format format, const std::string& patch_path, const std::string& filename) {
+    auto patch = save_patch::read(patch_path);
+    auto m = mmap_file(filename);
+    auto d = save_payload(m.data);
+    auto& f = span_cast<pokemon_gen3_format>(d).front();
+    auto gv = f.game_version(f.check());
+    if (gv != patch.gv) {
+        throw std::runtime_error("the patch is for " + game_version_string(patch.gv) + ", the save is " + game_version_string(gv));
+    }
+    slot_writer writer(f, d, m.fd);
+    auto& save = writer.begin();
+    patch.apply(save, writer.session);
+    size_t sections = writer.session.dirty.size();
+    writer.commit();
+    if (format == output_format::jsonl) {
+        json_record(out).field("file", filename).field("patch", patch_path).field("records", patch.records.size())
+            .field("bytes", patch.bytes()).field("sections", sections);
+    } else {
+        out << "applied " << patch.records.size() << " ranges (" << patch.bytes() << " bytes in " << sections << " sections) to " << filename << '\n';
+    }
+    out.flush();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    output_format format = output_format::text;
+    std::string patch_path;
+    std::vector<std::string> rest;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (parse_output_format(args[i], format)) {
+        } else if ((args[i] == "--output" || args[i] == "-o") && i + 1 < args.size()) {
+            patch_path = args[++i];
+        } else {
+            rest.push_back(args[i]);
+        }
+    }
+    output_buffer out;
+    try {
+        if (rest.size() == 3 && rest[0] == "diff") {
+            return diff(out, format, rest[1], rest[2], patch_path);
+        } else if (rest.size() == 3 && rest[0] == "apply") {
+            return apply(out, format, rest[1], rest[2]);
+        }
+    } catch (const std::runtime_error& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+    out << "usage: save-diff [--format=text|jsonl] diff old-save new-save [-o patch-file]\n";
+    out << "       save-diff [--format=text|jsonl] apply patch-file save\n";
+    return 1;
+}
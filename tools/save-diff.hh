@@ -0,0 +1,420 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <fstream>
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "pokemon-gen3-format.hh"
+#include "pokemon-box-kernels.hh"
+
+constexpr std::array<std::string_view, num_sections> section_names = {
+    "trainer_info",
+    "team_items",
+    "game_state",
+    "misc_data",
+    "rival_info",
+    "pc_buffer_a",
+    "pc_buffer_b",
+    "pc_buffer_c",
+    "pc_buffer_d",
+    "pc_buffer_e",
+    "pc_buffer_f",
+    "pc_buffer_g",
+    "pc_buffer_h",
+    "pc_buffer_i",
+};
+
+struct byte_range {
+    uint16_t offset;
+    uint16_t length;
+};
+
+//the changed bytes of one section, empty when both saves hold the same data
+struct section_diff {
+    section_type id;
+    bool identical;
+    std::vector<byte_range> ranges;
+};
+
+//changed bytes closer together than this are one range, a range header costs about as much
+constexpr size_t diff_merge_gap = 8;
+//equal blocks of this size are skipped with one memcmp, which libc does with vector compares
+constexpr size_t diff_block = 64;
+
+//the two sections are found by id, so they can sit at any rotation in their saves. the stored
+//checksum is compared first, and only a matching pair is memcmp'd in full to confirm it
+section_diff diff_section(const section& a, const section& b) {
+    auto id = a.section_id;
+    section_diff d{id, false, {}};
+    const size_t length = section_lengths[id];
+    if (a.checksum == b.checksum && std::memcmp(a.data.data(), b.data.data(), length) == 0) {
+        d.identical = true;
+        return d;
+    }
+    std::optional<size_t> start;
+    size_t last = 0;
+    auto close_range = [&] {
+        if (start) {
+            d.ranges.push_back({static_cast<uint16_t>(*start), static_cast<uint16_t>(last + 1 - *start)});
+            start.reset();
+        }
+    };
+    for (size_t block = 0; block < length; block += diff_block) {
+        size_t n = std::min(diff_block, length - block);
+        if (std::memcmp(a.data.data() + block, b.data.data() + block, n) == 0) {
+            continue;
+        }
+        for (size_t i = block; i < block + n; i++) {
+            if (a.data[i] == b.data[i]) {
+                continue;
+            }
+            if (start && i - last > diff_merge_gap) {
+                close_range();
+            }
+            if (!start) {
+                start = i;
+            }
+            last = i;
+        }
+    }
+    close_range();
+    //only the footer differed
+    d.identical = d.ranges.empty();
+    return d;
+}
+
+std::array<section_diff, num_sections> diff_saves(game_save& a, game_save& b) {
+    std::array<section_diff, num_sections> diffs;
+    for (size_t id = 0; id < num_sections; id++) {
+        auto type = static_cast<section_type>(id);
+        diffs[id] = diff_section(a.get_section_by_id(type), b.get_section_by_id(type));
+    }
+    return diffs;
+}
+
+//where a pokemon is, box 0xff is the party as in pokemon-index
+struct pokemon_location {
+    uint8_t box;
+    uint8_t slot;
+
+    bool operator==(const pokemon_location&) const = default;
+
+    std::string to_string() const {
+        if (box == 0xff) {
+            return "party " + std::to_string(slot + 1);
+        }
+        return "box " + std::to_string(box + 1) + " slot " + std::to_string(slot + 1);
+    }
+};
+
+struct located_pokemon {
+    pokemon_location where;
+    uint8_t level;
+    pokemon_box decoded;
+};
+
+//the valid party and pc pokemon of a save, decoded
+std::vector<located_pokemon> collect_pokemon(pokemon_gen3_format& f, game_save& save) {
+    std::vector<located_pokemon> all;
+    auto team_items_section = static_cast<section_team_items>(save.get_section_by_id(section_type::team_items));
+    auto party = team_items_section.get_pokemon_party(f.game_version(save));
+    for (size_t i = 0; i < party.size(); i++) {
+        pokemon_box decoded;
+        if (!decode_and_check(party[i], decoded)) {
+            continue;
+        }
+        all.push_back({{0xff, static_cast<uint8_t>(i)}, party[i].level, decoded});
+    }
+    decode_pc_buffer(pc_buffer_view(save), [&](const pokemon_box& decoded, size_t i, bool valid) {
+        if (valid) {
+            auto where = pokemon_location{static_cast<uint8_t>(i / pc_buffer_view::slots_per_box), static_cast<uint8_t>(i % pc_buffer_view::slots_per_box)};
+            all.push_back({where, decoded.level(), decoded});
+        }
+    });
+    return all;
+}
+
+enum class pokemon_change_kind {
+    added,
+    removed,
+    moved,
+    changed,
+};
+
+constexpr std::array<std::string_view, 4> pokemon_change_kind_names = {
+    "added",
+    "removed",
+    "moved",
+    "changed",
+};
+
+struct pokemon_change {
+    pokemon_change_kind kind;
+    std::optional<located_pokemon> before;
+    std::optional<located_pokemon> after;
+    //what changed for a pokemon in both saves, e.g. "level 15 -> 16"
+    std::vector<std::string> details;
+};
+
+std::vector<std::string> pokemon_differences(const located_pokemon& a, const located_pokemon& b) {
+    std::vector<std::string> details;
+    auto& x = a.decoded;
+    auto& y = b.decoded;
+    if (x.national_id() != y.national_id()) {
+        details.push_back("species " + std::string(x.species_name()) + " -> " + std::string(y.species_name()));
+    }
+    if (a.level != b.level) {
+        details.push_back("level " + std::to_string(a.level) + " -> " + std::to_string(b.level));
+    }
+    if (x.growth.experience != y.growth.experience) {
+        details.push_back("experience " + std::to_string(x.growth.experience) + " -> " + std::to_string(y.growth.experience));
+    }
+    if (x.growth.item_held != y.growth.item_held) {
+        details.push_back("item " + std::to_string(x.growth.item_held) + " -> " + std::to_string(y.growth.item_held));
+    }
+    if (x.nickname != y.nickname) {
+        details.push_back("nickname " + x.nickname_str() + " -> " + y.nickname_str());
+    }
+    if (x.attacks.moves != y.attacks.moves) {
+        details.push_back("moves");
+    } else if (x.attacks.pp != y.attacks.pp) {
+        details.push_back("pp");
+    }
+    if (std::memcmp(&x.evs_condition, &y.evs_condition, sizeof(x.evs_condition)) != 0) {
+        details.push_back("evs/condition");
+    }
+    if (x.growth.friendship != y.growth.friendship) {
+        details.push_back("friendship " + std::to_string(x.growth.friendship) + " -> " + std::to_string(y.growth.friendship));
+    }
+    if (details.empty() && std::memcmp(&x, &y, sizeof(pokemon_box)) != 0) {
+        details.push_back("other data");
+    }
+    return details;
+}
+
+//pokemon are matched by personality and original trainer id. copies sharing both (cloned or
+//traded back) are paired up at the same location first and in order after that
+std::vector<pokemon_change> diff_pokemon(const std::vector<located_pokemon>& before, const std::vector<located_pokemon>& after) {
+    using key = std::pair<uint32_t, uint32_t>;
+    std::map<key, std::pair<std::vector<const located_pokemon*>, std::vector<const located_pokemon*>>> by_key;
+    for (auto& p: before) {
+        by_key[{p.decoded.personality, p.decoded.original_trainer_id}].first.push_back(&p);
+    }
+    for (auto& p: after) {
+        by_key[{p.decoded.personality, p.decoded.original_trainer_id}].second.push_back(&p);
+    }
+    std::vector<pokemon_change> changes;
+    auto pair_up = [&](const located_pokemon* a, const located_pokemon* b) {
+        auto details = pokemon_differences(*a, *b);
+        if (a->where != b->where) {
+            changes.push_back({pokemon_change_kind::moved, *a, *b, std::move(details)});
+        } else if (!details.empty()) {
+            changes.push_back({pokemon_change_kind::changed, *a, *b, std::move(details)});
+        }
+    };
+    for (auto& [k, lists]: by_key) {
+        auto& [a, b] = lists;
+        for (auto& x: a) {
+            auto same_place = std::find_if(b.begin(), b.end(), [&](auto* y) { return y && y->where == x->where; });
+            if (same_place != b.end()) {
+                pair_up(x, *same_place);
+                x = nullptr;
+                *same_place = nullptr;
+            }
+        }
+        std::erase(a, nullptr);
+        std::erase(b, nullptr);
+        size_t paired = std::min(a.size(), b.size());
+        for (size_t i = 0; i < paired; i++) {
+            pair_up(a[i], b[i]);
+        }
+        for (size_t i = paired; i < a.size(); i++) {
+            changes.push_back({pokemon_change_kind::removed, *a[i], std::nullopt, {}});
+        }
+        for (size_t i = paired; i < b.size(); i++) {
+            changes.push_back({pokemon_change_kind::added, std::nullopt, *b[i], {}});
+        }
+    }
+    //in the order they appear in the newer save, removals at the end
+    auto place = [](const pokemon_change& c) {
+        auto& p = c.after ? c.after : c.before;
+        return std::make_tuple(!c.after, p->where.box == 0xff ? -1 : p->where.box, p->where.slot);
+    };
+    std::sort(changes.begin(), changes.end(), [&](auto& x, auto& y) { return place(x) < place(y); });
+    return changes;
+}
+
+//the event flag array in save block 1, which starts at the team_items section, by game_version
+struct flag_layout {
+    size_t offset;
+    size_t size;
+};
+
+constexpr std::array<flag_layout, 3> flag_layouts = {{
+    {0x1220, 0x120},
+    {0x0ee0, 0x120},
+    {0x1270, 0x12c},
+}};
+
+struct flag_change {
+    uint16_t flag;
+    bool set;
+};
+
+std::vector<flag_change> diff_flags(game_save& a, game_save& b, game_version gv) {
+    auto layout = flag_layouts[gv];
+    auto x = a.get_sections_contiguous(section_type::team_items, section_type::rival_info);
+    auto y = b.get_sections_contiguous(section_type::team_items, section_type::rival_info);
+    std::vector<flag_change> changes;
+    for (size_t i = 0; i < layout.size; i++) {
+        auto toggled = static_cast<uint8_t>(x[layout.offset + i] ^ y[layout.offset + i]);
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (toggled >> bit & 1) {
+                bool set = static_cast<uint8_t>(y[layout.offset + i]) >> bit & 1;
+                changes.push_back({static_cast<uint16_t>(i * 8 + bit), set});
+            }
+        }
+    }
+    return changes;
+}
+
+//the wonder card a save holds, ruby/sapphire keep theirs elsewhere and are not covered
+std::optional<mystery_gift_wonder_card> wonder_card(pokemon_gen3_format& f, game_save& save) {
+    auto gv = f.game_version(save);
+    if (gv == game_version::ruby_sapphire) {
+        return std::nullopt;
+    }
+    size_t offset = gv == game_version::emerald ? offsetof(mystery_gift_save_format_emerald, wonder_card) : offsetof(mystery_gift_save_format_frlg, wonder_card);
+    mystery_gift_wonder_card card;
+    std::memcpy(&card, save.get_section_by_id(section_type::rival_info).data.data() + offset, sizeof(card));
+    if (std::all_of(card.data.begin(), card.data.end(), [](std::byte b) { return b == std::byte{0}; })) {
+        return std::nullopt;
+    }
+    try {
+        card.check();
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+    return card;
+}
+
+//a patch is the changed byte ranges of a diff with the newer save's bytes, by section id so it
+//applies to a save at any rotation. the file is a small header and then the records: section id,
+//offset, length and the bytes
+struct save_patch {
+    static constexpr uint32_t magic = 0x54504b50; //"PKPT"
+    static constexpr uint32_t version = 1;
+
+    struct record {
+        section_type id;
+        uint16_t offset;
+        std::vector<std::byte> bytes;
+    };
+
+    game_version gv;
+    std::vector<record> records;
+
+    static save_patch from_diff(const std::array<section_diff, num_sections>& diffs, game_save& newer, game_version gv) {
+        save_patch p{gv, {}};
+        for (auto& d: diffs) {
+            auto& s = newer.get_section_by_id(d.id);
+            for (auto& r: d.ranges) {
+                p.records.push_back({d.id, r.offset, {s.data.begin() + r.offset, s.data.begin() + r.offset + r.length}});
+            }
+        }
+        return p;
+    }
+
+    size_t bytes() const {
+        size_t n = 0;
+        for (auto& r: records) {
+            n += r.bytes.size();
+        }
+        return n;
+    }
+
+    //the touched sections get their new checksums when the session commits
+    void apply(game_save& save, edit_session& session) const {
+        for (auto& r: records) {
+            check_m(r.id < num_sections);
+            check_m(r.offset + r.bytes.size() <= section_lengths[r.id]);
+            session.write(save.get_section_by_id(r.id), r.offset, std::span<const std::byte>(r.bytes));
+        }
+    }
+
+    template<typename T>
+    static void write_pod(std::ostream& out, const T& x) {
+        out.write(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+
+    template<typename T>
+    static void read_pod(std::istream& in, T& x) {
+        in.read(reinterpret_cast<char*>(&x), sizeof(x));
+    }
+
+    void write(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            write_pod(out, magic);
+            write_pod(out, version);
+            write_pod(out, static_cast<uint32_t>(gv));
+            write_pod(out, static_cast<uint32_t>(records.size()));
+            for (auto& r: records) {
+                write_pod(out, static_cast<uint16_t>(r.id));
+                write_pod(out, r.offset);
+                write_pod(out, static_cast<uint16_t>(r.bytes.size()));
+                out.write(reinterpret_cast<const char*>(r.bytes.data()), r.bytes.size());
+            }
+            if (!out) {
+                throw std::runtime_error(tmp + ": write failed");
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+    }
+
+    static save_patch read(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+        uint32_t m = 0, v = 0, g = 0, count = 0;
+        read_pod(in, m);
+        read_pod(in, v);
+        read_pod(in, g);
+        read_pod(in, count);
+        if (!in || m != magic || v != version) {
+            throw std::runtime_error(path + ": not a version " + std::to_string(version) + " save patch");
+        }
+        save_patch p{static_cast<game_version>(g), {}};
+        for (uint32_t i = 0; i < count; i++) {
+            uint16_t id = 0, offset = 0, length = 0;
+            read_pod(in, id);
+            read_pod(in, offset);
+            read_pod(in, length);
+            if (!in || id >= num_sections || offset + length > section_lengths[id]) {
+                throw std::runtime_error(path + ": truncated or corrupt save patch");
+            }
+            record r{static_cast<section_type>(id), offset, std::vector<std::byte>(length)};
+            in.read(reinterpret_cast<char*>(r.bytes.data()), length);
+            if (!in) {
+                throw std::runtime_error(path + ": truncated or corrupt save patch");
+            }
+            p.records.push_back(std::move(r));
+        }
+        return p;
+    }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+bool is_save_file(const std::filesystem::path& p) {
+    return p.extension() == ".sav" || p.extension() == ".srm";
+}
+
+//expands every directory argument into the .sav/.srm files below it, sorted within that argument,
+//other arguments are kept as they are
+std::vector<std::string> collect_save_files(const std::vector<std::string>& paths) {
+    std::vector<std::string> filenames;
+    for (auto& path: paths) {
+        if (!std::filesystem::is_directory(path)) {
+            filenames.push_back(path);
+            continue;
+        }
+        size_t first = filenames.size();
+        try {
+            for (auto& entry: std::filesystem::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file() && is_save_file(entry.path())) {
+                    filenames.push_back(entry.path().string());
+                }
+            }
+        } catch (const std::filesystem::filesystem_error& e) {
+            throw std::runtime_error(e.what());
+        }
+        std::sort(filenames.begin() + first, filenames.end());
+    }
+    return filenames;
+}
@@ -0,0 +1,181 @@
+#include "mmap.hh"
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <filesystem>
+#include <cstdio>
+#include <cassert>
+
+#include "pokemon-gen3-format.hh"
+#include "save-generator.hh"
+#include "thread-pool.hh"
+#include "output.hh"
+
+//saves written to a directory are spread over subdirectories of this many, so no directory ends
+//up with millions of entries
+constexpr size_t saves_per_directory = 1000;
+
+void write_all(int fd, const void* data, size_t size, off_t offset, const std::string& filename) {
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+std::string save_path(const std::string& directory, size_t i) {
+    std::array<char, 64> name;
+    std::snprintf(name.data(), name.size(), "/%05zu/%08zu.sav", i / saves_per_directory, i);
+    return directory + name.data();
+}
+
+std::optional<game_version> parse_game(std::string_view s) {
+    if (s == "rs" || s == "ruby" || s == "sapphire") {
+        return game_version::ruby_sapphire;
+    } else if (s == "frlg" || s == "firered" || s == "leafgreen") {
+        return game_version::leafgreen_firered;
+    } else if (s == "emerald") {
+        return game_version::emerald;
+    } else if (s == "mixed") {
+        return std::nullopt;
+    }
+    throw std::runtime_error("unknown game " + std::string(s) + ", expected rs, frlg, emerald or mixed");
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    size_t count = 0;
+    save_generator_options options;
+    output_format format = output_format::text;
+    std::string directory;
+    std::string stream;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if (args[i] == "--count" && i + 1 < args.size()) {
+                count = std::stoull(args[++i]);
+            } else if (args[i] == "--seed" && i + 1 < args.size()) {
+                options.seed = std::stoull(args[++i]);
+            } else if (args[i] == "--game" && i + 1 < args.size()) {
+                options.game = parse_game(args[++i]);
+            } else if (args[i] == "--fill" && i + 1 < args.size()) {
+                options.box_fill = std::stod(args[++i]);
+            } else if (args[i] == "--corrupt" && i + 1 < args.size()) {
+                options.corruption = std::stod(args[++i]);
+            } else if (args[i] == "--stream" && i + 1 < args.size()) {
+                stream = args[++i];
+            } else if ((args[i] == "--output" || args[i] == "-o") && i + 1 < args.size()) {
+                directory = args[++i];
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                throw std::runtime_error("unknown argument " + args[i]);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (count == 0 || directory.empty() == stream.empty()) {
+        std::cout << "usage: save-generator --count N (-o directory | --stream file) [--seed N] [--game rs|frlg|emerald|mixed]" << std::endl;
+        std::cout << "                      [--fill 0.5] [--corrupt 0.01] [--jobs N] [--format=text|jsonl]" << std::endl;
+        return 1;
+    }
+
+    //a packed stream is every save back to back, 128KiB apart, so save i can be written at its
+    //offset by whichever worker generated it
+    int stream_fd = -1;
+    if (!stream.empty()) {
+        stream_fd = open(stream.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (stream_fd < 0 || ftruncate(stream_fd, count * sizeof(pokemon_gen3_format)) < 0) {
+            std::cout << "error: " << stream << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+
+    std::array<std::atomic<size_t>, save_corruption_names.size()> corruptions{};
+    std::atomic<size_t> errors = 0;
+    std::string first_error;
+    std::mutex error_mutex;
+    auto start = std::chrono::steady_clock::now();
+    {
+        thread_pool pool(jobs);
+        //one task per batch of saves, each with its own buffer reused for every save of the batch
+        constexpr size_t batch = 256;
+        for (size_t first = 0; first < count; first += batch) {
+            pool.submit([&, first] {
+                auto f = std::make_unique<pokemon_gen3_format>();
+                for (size_t i = first; i < std::min(first + batch, count); i++) {
+                    try {
+                        corruptions[static_cast<size_t>(generate_save(*f, i, options))]++;
+                        if (stream_fd >= 0) {
+                            write_all(stream_fd, f.get(), sizeof(*f), i * sizeof(*f), stream);
+                            continue;
+                        }
+                        auto path = save_path(directory, i);
+                        if (i % saves_per_directory == 0 || i == first) {
+                            std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+                        }
+                        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                        if (fd < 0) {
+                            throw std::runtime_error(path + ": " + strerror(errno));
+                        }
+                        write_all(fd, f.get(), sizeof(*f), 0, path);
+                        close(fd);
+                    } catch (const std::exception& e) {
+                        std::lock_guard lock(error_mutex);
+                        if (errors++ == 0) {
+                            first_error = e.what();
+                        }
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+    if (stream_fd >= 0) {
+        close(stream_fd);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = count * sizeof(pokemon_gen3_format) / 1e6;
+
+    output_buffer out;
+    if (format == output_format::jsonl) {
+        json_record record(out);
+        record.field("saves", count).field("output", stream.empty() ? directory : stream).field("seed", options.seed)
+            .field("seconds", seconds).field("mb_per_s", megabytes / seconds).field("errors", errors.load());
+        for (size_t i = 1; i < corruptions.size(); i++) {
+            record.field(save_corruption_names[i], corruptions[i].load());
+        }
+        if (errors) {
+            record.field("error", first_error);
+        }
+    } else {
+        if (errors) {
+            out << "error: " << first_error << " (and " << errors.load() - 1 << " more)\n";
+        }
+        out << count << " saves written to " << (stream.empty() ? directory : stream) << " in " << seconds << " s, "
+            << megabytes / seconds << " MB/s, " << count - corruptions[0].load() << " corrupted (";
+        for (size_t i = 1; i < corruptions.size(); i++) {
+            out << (i > 1 ? ", " : "") << corruptions[i].load() << ' ' << save_corruption_names[i];
+        }
+        out << "), " << errors.load() << " errors\n";
+    }
+    if (!out.try_flush()) {
+        return 1;
+    }
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "pokemon-gen3-format.hh"
+
+//small, fast and good enough for test data, seeded per file so a corpus comes out the same
+//whatever order or thread its files are generated on
+struct splitmix64 {
+    uint64_t state;
+
+    uint64_t operator()() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    //in [0, n)
+    uint64_t below(uint64_t n) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>((*this)()) * n) >> 64);
+    }
+
+    bool chance(double p) {
+        return (*this)() < p * 18446744073709551616.0;
+    }
+};
+
+//what a generated save is deliberately broken by, if anything
+enum class save_corruption {
+    none,
+    //a byte of a section's checksummed data, check() fails
+    section_data,
+    //a section's signature, check() fails
+    signature,
+    //a byte of one stored pokemon, check() passes but that entry's own checksum doesn't
+    pokemon_data,
+};
+
+constexpr std::array<std::string_view, 4> save_corruption_names = {
+    "none",
+    "section_data",
+    "signature",
+    "pokemon_data",
+};
+
+struct save_generator_options {
+    uint64_t seed = 1;
+    //one game for the whole corpus, or unset to pick one per save
+    std::optional<game_version> game;
+    //the chance of each of the 420 pc slots being occupied
+    double box_fill = 0.5;
+    //the chance of a save being corrupted in one of the ways above
+    double corruption = 0;
+};
+
+//trainer info offsets shared by all three games
+constexpr size_t trainer_name_offset = 0x00;
+constexpr size_t trainer_id_offset = 0x0a;
+constexpr size_t pokedex_owned_offset = 0x28;
+constexpr size_t pokedex_seen_offset = 0x5c;
+constexpr size_t game_code_offset = 0xac;
+
+//a plausible random pokemon for trainer_id, decrypted and with its checksum set
+pokemon_box generate_pokemon(splitmix64& rng, uint32_t trainer_id, std::string_view trainer_name) {
+    pokemon_box p{};
+    p.personality = static_cast<uint32_t>(rng());
+    //a few were traded in
+    p.original_trainer_id = rng.chance(0.9) ? trainer_id : static_cast<uint32_t>(rng());
+    uint16_t national_id = 1 + rng.below(species_table::size - 1);
+    p.growth.species = species.internal_ids[national_id];
+    p.growth.item_held = rng.chance(0.2) ? 1 + rng.below(376) : 0;
+    const auto& table = experience_table_for(national_id);
+    uint8_t level = 1 + rng.below(100);
+    uint32_t next = level < 100 ? table[level] : table[99] + 1;
+    p.growth.experience = table[level - 1] + rng.below(next - table[level - 1]);
+    p.growth.friendship = rng.below(256);
+    for (size_t i = 0; i < p.attacks.moves.size(); i++) {
+        p.attacks.moves[i] = i == 0 || rng.chance(0.8) ? 1 + rng.below(354) : 0;
+        p.attacks.pp[i] = p.attacks.moves[i] ? 5 + rng.below(36) : 0;
+    }
+    //at most 510 evs in total
+    uint32_t ev_budget = rng.below(511);
+    for (auto* ev: {&p.evs_condition.hp_ev, &p.evs_condition.attack_ev, &p.evs_condition.defense_ev,
+            &p.evs_condition.speed_ev, &p.evs_condition.sp_attack_ev, &p.evs_condition.sp_defense_ev}) {
+        *ev = rng.below(std::min<uint32_t>(ev_budget, 255) + 1);
+        ev_budget -= *ev;
+    }
+    p.misc.met_location = rng.below(256);
+    p.misc.iv_egg_ability = rng() & 0x3fffffff;
+    p.misc.iv_egg_ability |= static_cast<uint32_t>(rng.below(2)) << 31;
+    //english, with its species name as the nickname
+    p.language = 2;
+    p.misc_flags = 0x02;
+    std::string name(species_name(national_id));
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) { return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c; });
+    try {
+        p.set_nickname(name);
+    } catch (const std::runtime_error&) {
+        p.set_nickname("POKEMON");
+    }
+    p.set_original_trainer_name(trainer_name);
+    p.update_checksum();
+    return p;
+}
+
+//fills f with a valid save of two slots, the older one a copy of the newer under other section
+//rotations, then breaks it as options.corruption says. the returned value is what was broken
+save_corruption generate_save(pokemon_gen3_format& f, uint64_t file_index, const save_generator_options& options) {
+    //the index goes through the mixer first, a plain multiple of the increment would make file i + 1
+    //replay the stream of file i shifted by one draw
+    splitmix64 index_mix{file_index};
+    splitmix64 rng{options.seed ^ index_mix()};
+    std::memset(&f, 0, sizeof(f));
+    auto gv = options.game ? *options.game : static_cast<game_version>(rng.below(3));
+
+    //the data of every section laid out by id, the pc buffer spans pc_buffer_a..i
+    std::array<std::array<std::byte, sizeof(section::data)>, num_sections> by_id{};
+    auto& trainer = by_id[section_type::trainer_info];
+    std::string trainer_name = "ASH";
+    trainer_name[0] = 'A' + rng.below(26);
+    string_to_pokemon_string(trainer_name, std::span(reinterpret_cast<char*>(trainer.data() + trainer_name_offset), 7));
+    uint32_t trainer_id = static_cast<uint32_t>(rng());
+    std::memcpy(trainer.data() + trainer_id_offset, &trainer_id, sizeof(trainer_id));
+    //ruby/sapphire store 0 and fire red/leaf green 1, emerald keeps its security key here instead
+    uint32_t game_code = gv == game_version::ruby_sapphire ? 0 : gv == game_version::leafgreen_firered ? 1 : 2 + rng.below(UINT32_MAX - 2);
+    std::memcpy(trainer.data() + game_code_offset, &game_code, sizeof(game_code));
+    auto owned = [&](uint16_t national_id) {
+        for (size_t offset: {pokedex_owned_offset, pokedex_seen_offset}) {
+            trainer[offset + (national_id - 1) / 8] |= std::byte{1} << ((national_id - 1) % 8);
+        }
+    };
+
+    std::array team_size_offsets = {0x234, 0x34, 0x234};
+    std::array team_list_offsets = {0x238, 0x38, 0x238};
+    auto& team = by_id[section_type::team_items];
+    uint32_t team_size = 1 + rng.below(6);
+    std::memcpy(team.data() + team_size_offsets[gv], &team_size, sizeof(team_size));
+    for (uint32_t i = 0; i < team_size; i++) {
+        pokemon_party p{};
+        static_cast<pokemon_box&>(p) = generate_pokemon(rng, trainer_id, trainer_name);
+        owned(p.national_id());
+        p.level = p.pokemon_box::level();
+        p.total_hp = 10 + p.level * 3;
+        p.current_hp = rng.below(p.total_hp + 1);
+        for (auto* stat: {&p.attack, &p.defense, &p.speed, &p.sp_attack, &p.sp_defense}) {
+            *stat = 5 + rng.below(p.level * 3);
+        }
+        p = p.encoded();
+        std::memcpy(team.data() + team_list_offsets[gv] + i * sizeof(p), &p, sizeof(p));
+    }
+
+    {
+        sections_pc_buffer pc{};
+        for (auto& slot: pc.pc_buffer_pokemon) {
+            if (rng.chance(options.box_fill)) {
+                slot = generate_pokemon(rng, trainer_id, trainer_name);
+                owned(slot.national_id());
+                slot.encode();
+            }
+        }
+        for (size_t i = 0; i < pc.box_names.size(); i++) {
+            std::string name = "BOX" + std::to_string(i + 1);
+            string_to_pokemon_string(name, pc.box_names[i]);
+        }
+        auto bytes = std::as_bytes(std::span(&pc, 1));
+        for (size_t id = section_type::pc_buffer_a, offset = 0; offset < bytes.size(); id++) {
+            size_t n = std::min(section_lengths[id], bytes.size() - offset);
+            std::memcpy(by_id[id].data(), bytes.data() + offset, n);
+            offset += n;
+        }
+    }
+
+    //like the game, even save indexes are in slot a and odd ones in b, and every save starts its
+    //sections one id lower than the one before, so section i of a save has id i - save_index
+    uint32_t save_index = 1 + rng.below(10000);
+    for (uint32_t index: {save_index - 1, save_index}) {
+        auto* save = index % 2 == 0 ? &f.a : &f.b;
+        for (size_t i = 0; i < num_sections; i++) {
+            auto& s = save->sections[i];
+            s.section_id = static_cast<section_type>((i + num_sections - index % num_sections) % num_sections);
+            s.data = by_id[s.section_id];
+            s.signature = 0x08012025UL;
+            s.save_index = index;
+            s.checksum = s.calculate_checksum();
+        }
+    }
+
+    auto corruption = save_corruption::none;
+    if (rng.chance(options.corruption)) {
+        corruption = static_cast<save_corruption>(1 + rng.below(3));
+        auto& latest = f.check();
+        //the same section of both slots, otherwise check() would just fall back to the other one
+        auto id = static_cast<section_type>(rng.below(num_sections));
+        size_t byte = rng.below(section_lengths[id]);
+        int bit = rng.below(32);
+        switch (corruption) {
+            case save_corruption::section_data:
+                for (auto* save: {&f.a, &f.b}) {
+                    save->get_section_by_id(id).data[byte] ^= std::byte{1} << (bit % 8);
+                }
+                break;
+            case save_corruption::signature:
+                for (auto* save: {&f.a, &f.b}) {
+                    save->get_section_by_id(id).signature ^= 1u << bit;
+                }
+                break;
+            case save_corruption::pokemon_data: {
+                //the first party member always exists, flip one of its encrypted data bytes and
+                //fix up the section so only the pokemon's own checksum notices
+                auto& team_section = latest.get_section_by_id(section_type::team_items);
+                size_t offset = team_list_offsets[gv] + offsetof(pokemon_box, data) + rng.below(sizeof(pokemon_box::data));
+                team_section.data[offset] ^= std::byte{1} << rng.below(8);
+                team_section.checksum = team_section.calculate_checksum();
+                break;
+            }
+            case save_corruption::none:
+                break;
+        }
+    }
+    return corruption;
+}
@@ -5,24 +5,216 @@
 #include <numeric>
 #include <vector>
 #include <string>
+#include <filesystem>
+#include <algorithm>
+#include <mutex>
+#include <tuple>
+#include <optional>
 #include <cassert>
 
 #include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "thread-pool.hh"
+#include "io-uring-loader.hh"
+#include "validation-cache.hh"
+#include "save-files.hh"
+#include "output.hh"
+#include "stats.hh"
+
+struct check_result {
+    size_t arg_index;
+    std::string filename;
+    std::string error;
+};
+
+void check_save_data(std::span<std::byte> d) {
+    d = save_payload(d);
+    auto& f = span_cast<pokemon_gen3_format>(d).front();
+    f.check();
+}
+
+//identity is that of the descriptor d was read through, only needed with a cache
+std::string check_save_data(const std::string& filename, std::span<std::byte> d, const file_identity& identity, validation_cache* cache) {
+    uint64_t hash = 0;
+    if (cache) {
+        hash = footer_hash(d);
+        if (auto error = cache->lookup(filename, identity, hash)) {
+            return *error;
+        }
+    }
+    std::string error;
+    try {
+        check_save_data(d);
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    if (cache) {
+        cache->store(filename, identity, hash, error);
+    }
+    return error;
+}
+
+check_result check_save(size_t arg_index, const std::string& filename, validation_cache* cache) {
+    check_result r{arg_index, filename, {}};
+    try {
+        auto m = mmap_file(filename, mmap_mode::read_only);
+        auto identity = cache ? file_identity::of(m.fd, filename) : file_identity{};
+        r.error = check_save_data(filename, m.data, identity, cache);
+    } catch (const std::runtime_error& e) {
+        r.error = e.what();
+    }
+    return r;
+}
 
 int main(int argc, char* argv[]) {
     std::vector<std::string> args(argv + 1, argv + argc);
-    for (auto& filename: args) {
-        try {
-            auto m = mmap_file(filename);
-            auto d = m.data;
-            if (d.size() != 32 * 4096) {
-                throw std::runtime_error("wrong save file size");
+    size_t jobs = std::thread::hardware_concurrency();
+    bool use_io_uring = false;
+    output_format format = output_format::text;
+    std::string cache_path;
+    std::vector<std::string> paths;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format) || parse_stats_option(args[i])) {
+            } else if (args[i] == "--io-uring") {
+                use_io_uring = true;
+            } else if (args[i] == "--cache" && i + 1 < args.size()) {
+                cache_path = args[++i];
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                paths.push_back(args[i]);
             }
-            auto f = span_cast<pokemon_gen3_format>(d).front();
-            f.check();
-            std::cout << "good pokemon save: " << filename << std::endl;
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    //unchanged files since the last run with the same cache skip check() entirely
+    std::optional<validation_cache> cache;
+    if (!cache_path.empty()) {
+        cache.emplace(cache_path);
+    }
+
+    std::vector<check_result> results;
+    std::mutex results_mutex;
+    {
+        thread_pool pool(jobs);
+        auto check_and_record = [&](size_t arg_index, std::string filename) {
+            auto r = check_save(arg_index, filename, cache ? &*cache : nullptr);
+            std::lock_guard lock(results_mutex);
+            results.push_back(std::move(r));
+        };
+        //directories are walked recursively, every directory listing is its own task so
+        //the walk of a large tree is spread across the pool along with the checks
+        std::function<void(size_t, std::filesystem::path)> walk = [&](size_t arg_index, std::filesystem::path dir) {
+            try {
+                for (auto& entry: std::filesystem::directory_iterator(dir)) {
+                    //like recursive_directory_iterator links to directories aren't followed, one
+                    //pointing back up the tree would be walked forever
+                    if (entry.is_directory() && !entry.is_symlink()) {
+                        pool.submit([&walk, arg_index, p = entry.path()]{ walk(arg_index, p); });
+                    } else if (entry.is_regular_file() && is_save_file(entry.path())) {
+                        pool.submit([&check_and_record, arg_index, p = entry.path()]{ check_and_record(arg_index, p.string()); });
+                    }
+                }
+            } catch (const std::filesystem::filesystem_error& e) {
+                std::lock_guard lock(results_mutex);
+                results.push_back({arg_index, dir.string(), e.what()});
+            }
+        };
+        if (use_io_uring) {
+            //the loader reads the next batch of files into its fixed buffers while the pool checks
+            //the last one
+            std::vector<std::string> filenames;
+            std::vector<size_t> arg_indexes;
+            for (size_t i = 0; i < paths.size(); i++) {
+                try {
+                    for (auto& filename: collect_save_files({paths[i]})) {
+                        filenames.push_back(std::move(filename));
+                        arg_indexes.push_back(i);
+                    }
+                } catch (const std::runtime_error& e) {
+                    results.push_back({i, paths[i], e.what()});
+                }
+            }
+            io_uring_loader loader;
+            loader.stat_files = cache.has_value();
+            loader.load(filenames, [&](std::span<loaded_file> batch) {
+                for (auto& file: batch) {
+                    pool.submit([&, &file = file] {
+                        check_result r{arg_indexes[file.index], filenames[file.index], file.error};
+                        if (r.error.empty() && file.truncated) {
+                            //bigger than the loader's buffers, mapped whole so it is judged on
+                            //its real size like on the default path
+                            r = check_save(r.arg_index, r.filename, cache ? &*cache : nullptr);
+                        } else if (r.error.empty()) {
+                            try {
+                                r.error = check_save_data(r.filename, file.data, file_identity::of(file.stat), cache ? &*cache : nullptr);
+                            } catch (const std::runtime_error& e) {
+                                r.error = e.what();
+                            }
+                        }
+                        std::lock_guard lock(results_mutex);
+                        results.push_back(std::move(r));
+                    });
+                }
+            }, [&] {
+                pool.wait();
+            });
+        }
+        for (size_t i = 0; i < paths.size() && !use_io_uring; i++) {
+            if (std::filesystem::is_directory(paths[i])) {
+                pool.submit([&walk, i, p = paths[i]]{ walk(i, p); });
+            } else {
+                pool.submit([&check_and_record, i, p = paths[i]]{ check_and_record(i, p); });
+            }
+        }
+        pool.wait();
+    }
+
+    //results arrive in completion order, report them in argument order then path order
+    std::sort(results.begin(), results.end(), [](auto& a, auto& b) {
+        return std::tie(a.arg_index, a.filename) < std::tie(b.arg_index, b.filename);
+    });
+    output_buffer out;
+    size_t errors = 0;
+    {
+        STATS_SCOPE(output);
+        for (auto& r: results) {
+            errors += !r.error.empty();
+            if (format == output_format::jsonl) {
+                json_record record(out);
+                record.field("file", r.filename).field("good", r.error.empty());
+                if (!r.error.empty()) {
+                    record.field("error", r.error);
+                }
+            } else if (r.error.empty()) {
+                out << "good pokemon save: " << r.filename << '\n';
+            } else {
+                out << "error in " << r.filename << ": " << r.error << '\n';
+            }
+        }
+        if (format == output_format::jsonl) {
+            json_record(out).field("files", results.size()).field("good", results.size() - errors).field("errors", errors);
+        } else {
+            out << results.size() << " files checked, " << results.size() - errors << " good, " << errors << " errors\n";
+        }
+    }
+    //saved after the results are out, a cache that can't be written loses nothing but the next
+    //run's head start
+    bool cache_saved = true;
+    if (cache) {
+        try {
+            cache->save();
         } catch (const std::runtime_error& e) {
-            std::cout << "error in " << filename << ": " << e.what() << std::endl;
+            report_error(out, format, cache_path, e.what());
+            cache_saved = false;
         }
     }
+    if (!out.try_flush()) {
+        return 1;
+    }
+    stats_report(format);
+    return errors == 0 && cache_saved ? 0 : 1;
 }
@@ -0,0 +1,338 @@
+#include "mmap.hh"
+
+#include <sys/inotify.h>
+#include <poll.h>
+
+#include <iostream>
+#include <span>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <optional>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cassert>
+#include <cstring>
+
+#include "pokemon-gen3-format.hh"
+#include "save-container.hh"
+#include "dex-summary.hh"
+#include "validation-cache.hh"
+#include "thread-pool.hh"
+#include "save-files.hh"
+#include "output.hh"
+
+//events arriving this close together are handled as one batch, so a burst of writes to the same
+//save is validated once
+constexpr int settle_ms = 20;
+//a batch is closed this long after its first event even if events keep coming, so a file that is
+//written continuously still gets looked at
+constexpr int batch_deadline_ms = 100;
+
+struct watched_save {
+    file_identity identity;
+    uint64_t footer_hash;
+    std::string error;
+    dex_summary summary;
+};
+
+//nullopt once the file is gone, a file that can't be read or checked is kept with its error and
+//contributes nothing
+std::optional<watched_save> evaluate(const std::string& filename) {
+    watched_save w{};
+    try {
+        w.identity = file_identity::of(filename);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+    try {
+        auto m = mmap_file(filename, mmap_mode::read_only);
+        //the file that was read, which may already have replaced the one stat saw
+        w.identity = file_identity::of(m.fd, filename);
+        w.footer_hash = footer_hash(m.data);
+        auto& f = span_cast<pokemon_gen3_format>(save_payload(m.data)).front();
+        w.summary = summarize_save(f, f.check());
+    } catch (const std::runtime_error& e) {
+        w.error = e.what();
+        w.summary = {};
+    }
+    return w;
+}
+
+struct save_watch {
+    output_buffer& out;
+    output_format format;
+    int inotify_fd;
+    std::unordered_map<int, std::string> directories;
+    std::unordered_map<std::string, watched_save> saves;
+    dex_totals totals;
+
+    save_watch(output_buffer& out_, output_format format_): out(out_), format(format_) {
+        inotify_fd = inotify_init1(IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            throw std::runtime_error(std::string("inotify_init1: ") + strerror(errno));
+        }
+    }
+
+    ~save_watch() {
+        close(inotify_fd);
+    }
+
+    //watches dir and every directory below it, returns the save files found there
+    std::vector<std::string> watch(const std::string& dir) {
+        constexpr uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+        std::vector<std::string> found;
+        int wd = inotify_add_watch(inotify_fd, dir.c_str(), mask);
+        if (wd < 0) {
+            throw std::runtime_error(dir + ": " + strerror(errno));
+        }
+        directories[wd] = dir;
+        for (auto& entry: std::filesystem::directory_iterator(dir)) {
+            //links to directories aren't followed, one pointing back up the tree would never end
+            if (entry.is_directory() && !entry.is_symlink()) {
+                auto below = watch(entry.path().string());
+                found.insert(found.end(), below.begin(), below.end());
+            } else if (entry.is_regular_file() && is_save_file(entry.path())) {
+                found.push_back(entry.path().string());
+            }
+        }
+        return found;
+    }
+
+    void report(std::string_view event, const std::string& filename, const watched_save* w, const dex_summary& before, double latency_ms) {
+        auto after = totals.summary();
+        std::vector<std::string_view> gained, lost;
+        for (size_t i = 0; i < after.dex.size(); i++) {
+            if (after.dex[i] && !before.dex[i]) {
+                gained.push_back(species_name(i));
+            } else if (!after.dex[i] && before.dex[i]) {
+                lost.push_back(species_name(i));
+            }
+        }
+        if (format == output_format::jsonl) {
+            json_record record(out);
+            record.field("event", event).field("file", filename);
+            if (w) {
+                record.field("good", w->error.empty());
+                if (!w->error.empty()) {
+                    record.field("error", w->error);
+                }
+            }
+            record.field("dex", after.dex.count()).field("unown", after.unowns.count());
+            record.strings("gained", gained).strings("lost", lost);
+            record.field("latency_ms", latency_ms);
+            return;
+        }
+        out << event << ' ' << filename << ": ";
+        if (w) {
+            out << (w->error.empty() ? "good" : w->error) << ", ";
+        }
+        out << "dex " << after.dex.count() << " / " << after.dex.size() - 1 << ", unown " << after.unowns.count() << " / " << after.unowns.size();
+        for (auto name: gained) {
+            out << " +" << name;
+        }
+        for (auto name: lost) {
+            out << " -" << name;
+        }
+        out << '\n';
+    }
+
+    //takes the file's old contribution out of the totals and puts the new one in
+    void update(const std::string& filename, std::optional<watched_save> now, std::chrono::steady_clock::time_point seen) {
+        //an empty file is one being rewritten that was caught between the truncate and the write,
+        //it's looked at again when the writer closes it
+        if (now && now->identity.size == 0) {
+            return;
+        }
+        auto it = saves.find(filename);
+        if (it != saves.end() && now && it->second.identity == now->identity && it->second.footer_hash == now->footer_hash) {
+            return;
+        }
+        if (it == saves.end() && !now) {
+            return;
+        }
+        auto before = totals.summary();
+        std::string_view event = "added";
+        if (it != saves.end()) {
+            totals.remove(it->second.summary);
+            event = now ? "changed" : "removed";
+        }
+        if (now) {
+            totals.add(now->summary);
+            saves[filename] = std::move(*now);
+        } else {
+            saves.erase(it);
+        }
+        double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seen).count();
+        report(event, filename, now ? &saves[filename] : nullptr, before, latency_ms);
+    }
+
+    //blocks for the next batch of events and returns the save files they touched, seen is set to
+    //when the first event of the batch was read
+    std::set<std::string> wait_for_changes(std::chrono::steady_clock::time_point& seen) {
+        std::set<std::string> changed;
+        alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+        int timeout = -1;
+        std::chrono::steady_clock::time_point deadline;
+        for (;;) {
+            if (timeout >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    return changed;
+                }
+                timeout = static_cast<int>(std::min<decltype(left)>(left, settle_ms));
+            }
+            pollfd p{inotify_fd, POLLIN, 0};
+            int n = poll(&p, 1, timeout);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw std::runtime_error(std::string("poll: ") + strerror(errno));
+            }
+            if (n == 0) {
+                return changed;
+            }
+            ssize_t len = read(inotify_fd, buffer.data(), buffer.size());
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            if (len < 0) {
+                throw std::runtime_error(std::string("inotify read: ") + strerror(errno));
+            }
+            if (timeout < 0) {
+                seen = std::chrono::steady_clock::now();
+                deadline = seen + std::chrono::milliseconds(batch_deadline_ms);
+            }
+            for (ssize_t offset = 0; offset < len;) {
+                auto* e = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                offset += sizeof(inotify_event) + e->len;
+                if (e->mask & IN_Q_OVERFLOW) {
+                    //events were lost, look at everything again
+                    for (auto& [wd, dir]: directories) {
+                        for (auto& entry: std::filesystem::directory_iterator(dir)) {
+                            if (entry.is_regular_file() && is_save_file(entry.path())) {
+                                changed.insert(entry.path().string());
+                            }
+                        }
+                    }
+                    for (auto& [filename, w]: saves) {
+                        changed.insert(filename);
+                    }
+                    continue;
+                }
+                if (e->mask & IN_IGNORED) {
+                    directories.erase(e->wd);
+                    continue;
+                }
+                auto dir = directories.find(e->wd);
+                if (dir == directories.end() || e->len == 0) {
+                    continue;
+                }
+                std::string path = dir->second + "/" + e->name;
+                if (e->mask & IN_ISDIR) {
+                    if (e->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        try {
+                            for (auto& f: watch(path)) {
+                                changed.insert(f);
+                            }
+                        } catch (const std::exception&) {
+                            //gone again already
+                        }
+                    } else if (e->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        for (auto& [filename, w]: saves) {
+                            if (filename.starts_with(path + "/")) {
+                                changed.insert(filename);
+                            }
+                        }
+                    }
+                    continue;
+                }
+                //a new file is only looked at once it has been written and closed
+                if (!(e->mask & IN_CREATE) && is_save_file(path)) {
+                    changed.insert(path);
+                }
+            }
+            timeout = settle_ms;
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t jobs = std::thread::hardware_concurrency();
+    output_format format = output_format::text;
+    std::vector<std::string> dirs;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (parse_output_format(args[i], format)) {
+            } else if (parse_jobs_option(args, i, jobs)) {
+            } else {
+                dirs.push_back(args[i]);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    output_buffer out;
+    if (dirs.empty()) {
+        out << "usage: save-watch [--jobs N] [--format=text|jsonl] directory...\n";
+        return 1;
+    }
+
+    try {
+        save_watch w(out, format);
+        std::vector<std::string> filenames;
+        for (auto& dir: dirs) {
+            if (!std::filesystem::is_directory(dir)) {
+                throw std::runtime_error(dir + ": not a directory");
+            }
+            auto found = w.watch(dir);
+            filenames.insert(filenames.end(), found.begin(), found.end());
+        }
+        //the starting totals, every file read in parallel once
+        std::vector<std::optional<watched_save>> initial(filenames.size());
+        {
+            thread_pool pool(jobs);
+            for (size_t i = 0; i < filenames.size(); i++) {
+                pool.submit([&, i] {
+                    initial[i] = evaluate(filenames[i]);
+                });
+            }
+            pool.wait();
+        }
+        size_t errors = 0;
+        for (size_t i = 0; i < filenames.size(); i++) {
+            if (initial[i]) {
+                errors += !initial[i]->error.empty();
+                w.totals.add(initial[i]->summary);
+                w.saves[filenames[i]] = std::move(*initial[i]);
+            }
+        }
+        auto totals = w.totals.summary();
+        if (format == output_format::jsonl) {
+            json_record(out).field("event", "ready").field("files", w.saves.size()).field("errors", errors)
+                .field("directories", w.directories.size()).field("dex", totals.dex.count()).field("unown", totals.unowns.count());
+        } else {
+            out << "watching " << w.saves.size() << " saves (" << errors << " errors) in " << w.directories.size() << " directories, dex "
+                << totals.dex.count() << " / " << totals.dex.size() - 1 << ", unown " << totals.unowns.count() << " / " << totals.unowns.size() << '\n';
+        }
+        out.flush();
+
+        for (;;) {
+            std::chrono::steady_clock::time_point seen;
+            auto changed = w.wait_for_changes(seen);
+            for (auto& filename: changed) {
+                w.update(filename, evaluate(filename), seen);
+            }
+            out.flush();
+        }
+    } catch (const std::exception& e) {
+        out << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
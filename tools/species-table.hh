@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <string_view>
+
+#include "pokemon-names.hh"
+#include "species-id-conversion.hh"
+
+//the growth rate of a species, see experience_for_level in pokemon-levelling.hh
+enum class levelling_type {
+    medium_fast,
+    erratic,
+    fluctuating,
+    medium_slow,
+    fast,
+    slow,
+};
+
+constexpr std::pair<uint16_t, uint16_t> gen_id_range(uint8_t gen) {
+    if (gen == 1) {
+        return {1, 151};
+    } else if (gen == 2) {
+        return {152, 251};
+    } else if (gen == 3) {
+        return {252, 386};
+    } else {
+        return {};
+    }
+}
+
+//everything known about a species but its name packed into one byte: the levelling type in the
+//low three bits, the generation in the next two and then one bit per flag
+enum species_trait: uint8_t {
+    species_levelling_mask = 0b00000111,
+    species_gen_shift = 3,
+    species_gen_mask = 0b00011000,
+    species_legendary = 1 << 5,
+    species_mythical = 1 << 6,
+    species_starter = 1 << 7,
+};
+
+//all species metadata as one struct of arrays indexed by national id, entry 0 stands for an empty
+//or unknown species. built at compile time, so there is nothing to construct at startup
+struct species_table {
+    static constexpr size_t size = 387;
+
+    std::array<std::string_view, size> names;
+    std::array<uint8_t, size> traits;
+    std::array<uint16_t, size> internal_ids;
+};
+
+constexpr species_table make_species_table() {
+    //the levelling type of each species from 1 on, as the digit of its levelling_type
+    constexpr std::string_view levelling =
+        "3333333330" //1-10
+        "0000033300" //11-20
+        "0000000033" //21-30
+        "3333440044" //31-40
+        "0033300000" //41-50
+        "0000000553" //51-60
+        "3333333333" //61-70
+        "3553330000" //71-80
+        "0000000005" //81-90
+        "5333000000" //91-100
+        "0550000000" //101-110
+        "5540000005" //111-120
+        "5000005555" //121-130
+        "5000000000" //131-140
+        "0555555555" //141-150
+        "3333333333" //151-160
+        "0000444405" //161-170
+        "5044440033" //171-180
+        "3344033334" //181-190
+        "3300000304" //191-200
+        "0000003044" //201-210
+        "0035300005" //211-220
+        "5400455550" //221-230
+        "0005400000" //231-240
+        "5455555555" //241-250
+        "3333333333" //251-260
+        "0000000003" //261-270
+        "3333333005" //271-280
+        "5500225551" //281-290
+        "1133322404" //291-300
+        "4345550055" //301-310
+        "0012322552" //311-320
+        "2000444333" //321-330
+        "3311124400" //331-340
+        "2200111111" //341-350
+        "0344445430" //351-360
+        "0033311154" //361-370
+        "5555555555" //371-380
+        "555555";    //381-386
+    static_assert(levelling.size() == species_table::size - 1);
+    species_table t{};
+    t.names[0] = "error";
+    for (uint16_t n = 1; n < species_table::size; n++) {
+        uint8_t traits = levelling[n - 1] - '0';
+        for (uint8_t gen = 1; gen <= 3; gen++) {
+            if (n >= gen_id_range(gen).first && n <= gen_id_range(gen).second) {
+                traits |= gen << species_gen_shift;
+            }
+        }
+        bool legendary =
+            (n >= 144 && n <= 146) || n == 150 ||
+            (n >= 243 && n <= 245) || n == 249 || n == 250 ||
+            (n >= 377 && n <= 384);
+        bool mythical = n == 151 || n == 251 || n == 385 || n == 386;
+        bool starter =
+            (n >= 1 && n < 1 + 9) ||
+            (n >= 152 && n < 152 + 9) ||
+            (n >= 252 && n < 252 + 9);
+        traits |= (legendary ? species_legendary : 0) | (mythical ? species_mythical : 0) | (starter ? species_starter : 0);
+        t.names[n] = pokemon_names[n - 1];
+        t.traits[n] = traits;
+        t.internal_ids[n] = national_to_internal(n);
+    }
+    //the old range check treated 0 as gen 1
+    t.traits[0] = 1 << species_gen_shift;
+    return t;
+}
+
+constexpr species_table species = make_species_table();
+
+constexpr std::string_view species_name(uint16_t national_id) {
+    return species.names[national_id < species_table::size ? national_id : 0];
+}
+
+constexpr uint8_t gen(uint16_t national_id) {
+    if (national_id >= species_table::size) {
+        throw "error";
+    }
+    return (species.traits[national_id] & species_gen_mask) >> species_gen_shift;
+}
+
+constexpr levelling_type species_levelling_type(uint16_t national_id) {
+    return static_cast<levelling_type>(species.traits[national_id] & species_levelling_mask);
+}
+
+constexpr bool species_has(uint16_t national_id, species_trait trait) {
+    return national_id < species_table::size && (species.traits[national_id] & trait);
+}
+
+constexpr bool legendary(uint16_t national_id) {
+    return species_has(national_id, species_legendary);
+}
+
+constexpr bool mythical(uint16_t national_id) {
+    return species_has(national_id, species_mythical);
+}
+
+constexpr bool starter(uint16_t national_id) {
+    return species_has(national_id, species_starter);
+}
+
+static_assert(species_name(258) == "Mudkip");
+static_assert(gen(251) == 2 && gen(252) == 3);
+static_assert(legendary(150) && mythical(151) && starter(258) && !legendary(151));
+static_assert(species_levelling_type(133) == levelling_type::medium_fast);
+static_assert(species.internal_ids[257] == 282);
+
+//the unown forms in the order of pokemon_box::unown_form()
+constexpr std::string_view unown_letters = "ABCDEFGHIJKLMNOPQRSTUVWXYZ!?";
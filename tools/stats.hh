@@ -0,0 +1,244 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "perf-counters.hh"
+#include "output.hh"
+
+//--stats instrumentation: STATS_SCOPE(stage) times the rest of the enclosing block and
+//STATS_ADD(counter, n) counts, both only when --stats was given. without POKEMON_STATS (meson
+//-Dstats=false) the macros expand to nothing and only the option parsing and the report remain
+
+enum class stats_stage {
+    mmap,
+    check,
+    sections_contiguous,
+    decode,
+    output,
+};
+
+constexpr std::array<std::string_view, 5> stats_stage_names = {
+    "mmap",
+    "check",
+    "sections_contiguous",
+    "decode",
+    "output",
+};
+
+enum class stats_counter {
+    files,
+    bytes,
+    sections,
+    pokemon_decoded,
+    checksum_failures,
+};
+
+constexpr std::array<std::string_view, 5> stats_counter_names = {
+    "files",
+    "bytes",
+    "sections",
+    "pokemon_decoded",
+    "checksum_failures",
+};
+
+//the numbers of one thread, so the hot paths never share a cache line. blocks are owned by the
+//registry rather than the thread, so a pool's numbers outlive its workers
+struct stats_block {
+    std::array<uint64_t, stats_stage_names.size()> ns{};
+    std::array<uint64_t, stats_stage_names.size()> calls{};
+    std::array<perf_sample, stats_stage_names.size()> perf{};
+    std::array<uint64_t, stats_counter_names.size()> counters{};
+    std::unique_ptr<perf_counters> counters_of_thread;
+};
+
+struct stats_registry {
+    bool enabled = false;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<stats_block>> blocks;
+};
+
+stats_registry& stats() {
+    static stats_registry registry;
+    return registry;
+}
+
+stats_block& local_stats() {
+    static thread_local stats_block* block = nullptr;
+    if (!block) {
+        auto b = std::make_unique<stats_block>();
+        b->counters_of_thread = std::make_unique<perf_counters>();
+        if (b->counters_of_thread->available()) {
+            b->counters_of_thread->start();
+        } else {
+            b->counters_of_thread.reset();
+        }
+        std::lock_guard lock(stats().mutex);
+        block = b.get();
+        stats().blocks.push_back(std::move(b));
+    }
+    return *block;
+}
+
+struct stats_scope {
+    stats_stage stage;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+    perf_sample perf_start;
+
+    explicit stats_scope(stats_stage stage_): stage(stage_), active(stats().enabled) {
+        if (!active) {
+            return;
+        }
+        auto& b = local_stats();
+        if (b.counters_of_thread) {
+            perf_start = b.counters_of_thread->read();
+        }
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~stats_scope() {
+        if (!active) {
+            return;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto& b = local_stats();
+        auto i = static_cast<size_t>(stage);
+        b.ns[i] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        b.calls[i]++;
+        if (b.counters_of_thread) {
+            b.perf[i] += b.counters_of_thread->read() - perf_start;
+        }
+    }
+
+    stats_scope(const stats_scope&) = delete;
+    stats_scope& operator=(const stats_scope&) = delete;
+};
+
+void stats_add(stats_counter counter, uint64_t n) {
+    if (stats().enabled) {
+        local_stats().counters[static_cast<size_t>(counter)] += n;
+    }
+}
+
+#ifdef POKEMON_STATS
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+#define STATS_SCOPE(stage) stats_scope STATS_CONCAT(stats_scope_, __LINE__)(stats_stage::stage)
+#define STATS_ADD(counter, n) stats_add(stats_counter::counter, n)
+#else
+#define STATS_SCOPE(stage) static_cast<void>(0)
+#define STATS_ADD(counter, n) static_cast<void>(0)
+#endif
+
+//true for --stats, which turns the instrumentation on from here
+bool parse_stats_option(std::string_view arg) {
+    if (arg != "--stats") {
+        return false;
+    }
+    stats().enabled = true;
+    stats().start = std::chrono::steady_clock::now();
+    return true;
+}
+
+//the totals of all threads on stderr, so they never mix with the output they describe. call it
+//once the workers are idle
+void stats_report(output_format format) {
+    auto& r = stats();
+    if (!r.enabled) {
+        return;
+    }
+    output_buffer out(STDERR_FILENO);
+#ifndef POKEMON_STATS
+    out << "stats: not compiled in, reconfigure with -Dstats=true\n";
+    return;
+#endif
+    stats_block total;
+    {
+        std::lock_guard lock(r.mutex);
+        for (auto& b: r.blocks) {
+            for (size_t i = 0; i < stats_stage_names.size(); i++) {
+                total.ns[i] += b->ns[i];
+                total.calls[i] += b->calls[i];
+                total.perf[i] += b->perf[i];
+            }
+            for (size_t i = 0; i < stats_counter_names.size(); i++) {
+                total.counters[i] += b->counters[i];
+            }
+        }
+    }
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - r.start).count();
+
+    if (format == output_format::jsonl) {
+        json_record record(out);
+        record.field("stats", true).field("wall_ms", wall_ms).field("threads", r.blocks.size());
+        for (size_t i = 0; i < stats_stage_names.size(); i++) {
+            std::string stage(stats_stage_names[i]);
+            record.field(stage + "_calls", total.calls[i]).field(stage + "_ms", total.ns[i] / 1e6);
+            for (size_t c = 0; c < perf_counter_names.size(); c++) {
+                if (total.perf[i].values[c]) {
+                    record.field(stage + "_" + std::string(perf_counter_names[c]), *total.perf[i].values[c]);
+                }
+            }
+        }
+        for (size_t i = 0; i < stats_counter_names.size(); i++) {
+            record.field(stats_counter_names[i], total.counters[i]);
+        }
+        return;
+    }
+
+    //stage times add up over all threads, so they can exceed the wall time
+    auto pad = [&](std::string_view s, size_t width) {
+        out << s;
+        for (size_t i = s.size(); i < width; i++) {
+            out << ' ';
+        }
+    };
+    auto number = [&](auto x, size_t width) {
+        output_buffer n(-1);
+        n << x;
+        auto s = n.take();
+        for (size_t i = s.size(); i < width; i++) {
+            out << ' ';
+        }
+        out << s;
+    };
+    out << "stats: " << wall_ms << " ms wall, " << r.blocks.size() << " threads\n";
+    pad("stage", 20);
+    for (auto name: {"calls", "ms", "ns/call"}) {
+        number(name, 12);
+    }
+    for (auto name: perf_counter_names) {
+        number(name, 16);
+    }
+    out << '\n';
+    for (size_t i = 0; i < stats_stage_names.size(); i++) {
+        if (total.calls[i] == 0) {
+            continue;
+        }
+        pad(stats_stage_names[i], 20);
+        number(total.calls[i], 12);
+        number(total.ns[i] / 1e6, 12);
+        number(total.ns[i] / total.calls[i], 12);
+        for (auto& v: total.perf[i].values) {
+            if (v) {
+                number(*v, 16);
+            } else {
+                number("-", 16);
+            }
+        }
+        out << '\n';
+    }
+    for (size_t i = 0; i < stats_counter_names.size(); i++) {
+        pad(stats_counter_names[i], 20);
+        number(total.counters[i], 12);
+        out << '\n';
+    }
+}
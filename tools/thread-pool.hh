@@ -0,0 +1,158 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
+
+//work-stealing pool: every worker owns a deque, pushes and pops its own work at the back
+//and steals from the front of the other workers' deques when it runs dry
+struct thread_pool {
+    using task = std::function<void()>;
+
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_queue = 0;
+    std::atomic<size_t> queued = 0;
+    std::atomic<size_t> unfinished = 0;
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    bool stopping = false;
+
+    static size_t& worker_index() {
+        static thread_local size_t index = SIZE_MAX;
+        return index;
+    }
+
+    explicit thread_pool(size_t num_threads = std::thread::hardware_concurrency()) {
+        num_threads = std::max<size_t>(num_threads, 1);
+        for (size_t i = 0; i < num_threads; i++) {
+            queues.push_back(std::make_unique<worker_queue>());
+        }
+        for (size_t i = 0; i < num_threads; i++) {
+            threads.emplace_back([this, i]{ run(i); });
+        }
+    }
+
+    ~thread_pool() {
+        wait();
+        {
+            std::lock_guard lock(state_mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& t: threads) {
+            t.join();
+        }
+    }
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    //tasks submitted from inside a worker go to that worker's own deque
+    void submit(task t) {
+        size_t i = worker_index();
+        if (i >= queues.size()) {
+            i = next_queue++ % queues.size();
+        }
+        unfinished++;
+        {
+            std::lock_guard lock(queues[i]->mutex);
+            queues[i]->tasks.push_back(std::move(t));
+        }
+        {
+            std::lock_guard lock(state_mutex);
+            queued++;
+        }
+        work_available.notify_one();
+    }
+
+    //blocks until every submitted task, including tasks submitted by tasks, has finished
+    void wait() {
+        std::unique_lock lock(state_mutex);
+        all_done.wait(lock, [this]{ return unfinished == 0; });
+    }
+
+    std::optional<task> pop(size_t self) {
+        {
+            auto& q = *queues[self];
+            std::lock_guard lock(q.mutex);
+            if (!q.tasks.empty()) {
+                task t = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return t;
+            }
+        }
+        for (size_t n = 1; n < queues.size(); n++) {
+            auto& q = *queues[(self + n) % queues.size()];
+            std::lock_guard lock(q.mutex);
+            if (!q.tasks.empty()) {
+                task t = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return t;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void run(size_t self) {
+        worker_index() = self;
+        while (true) {
+            {
+                std::unique_lock lock(state_mutex);
+                work_available.wait(lock, [this]{ return stopping || queued > 0; });
+                if (queued == 0) {
+                    return;
+                }
+                queued--;
+            }
+            //queued counts tasks sitting in some deque, so having claimed one we are
+            //guaranteed to find it, though possibly only after another worker stole it
+            std::optional<task> t;
+            while (!(t = pop(self))) {
+                std::this_thread::yield();
+            }
+            (*t)();
+            if (--unfinished == 0) {
+                std::lock_guard lock(state_mutex);
+                all_done.notify_all();
+            }
+        }
+    }
+};
+
+//--jobs N, -j N or --jobs=N, with i moved past a separate value. returns false for any other
+//argument and throws std::invalid_argument for a value that isn't a positive number
+bool parse_jobs_option(const std::vector<std::string>& args, size_t& i, size_t& jobs) {
+    std::string_view value;
+    if ((args[i] == "--jobs" || args[i] == "-j") && i + 1 < args.size()) {
+        value = args[++i];
+    } else if (args[i].starts_with("--jobs=")) {
+        value = std::string_view(args[i]).substr(7);
+    } else {
+        return false;
+    }
+    size_t n = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+    if (ec != std::errc() || end != value.data() + value.size() || n == 0) {
+        throw std::invalid_argument("--jobs needs a positive number, not '" + std::string(value) + "'");
+    }
+    jobs = n;
+    return true;
+}
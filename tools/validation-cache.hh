@@ -0,0 +1,194 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <optional>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "pokemon-gen3-format.hh"
+
+struct file_identity {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+
+    bool operator==(const file_identity&) const = default;
+
+    static file_identity of(const struct stat& st) {
+        return {
+            static_cast<uint64_t>(st.st_dev),
+            static_cast<uint64_t>(st.st_ino),
+            static_cast<uint64_t>(st.st_size),
+            static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+        };
+    }
+
+    static file_identity of(const std::string& filename) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) < 0) {
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+        return of(st);
+    }
+
+    //the file that was actually opened, for anything remembered about its contents: a stat by name
+    //could already see a file written or renamed over it since
+    static file_identity of(int fd, const std::string& filename) {
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            throw std::runtime_error(filename + ": " + strerror(errno));
+        }
+        return of(st);
+    }
+};
+
+//fnv-1a over the 12 byte footer (id, checksum, signature, save_index) of all 28 sections, any save
+//the game or an emulator writes bumps save_index and changes the checksums of the slot it rewrites.
+//only the flash is hashed, an emulator footer after it doesn't matter
+uint64_t footer_hash(std::span<const std::byte> d) {
+    uint64_t hash = 0xcbf29ce484222325;
+    if (d.size() < sizeof(pokemon_gen3_format)) {
+        return hash;
+    }
+    for (size_t s = 0; s < 2 * num_sections; s++) {
+        auto footer = d.subspan(s * sizeof(section) + offsetof(section, section_id), sizeof(section) - offsetof(section, section_id));
+        for (auto b: footer) {
+            hash = (hash ^ static_cast<uint8_t>(b)) * 0x100000001b3;
+        }
+    }
+    return hash;
+}
+
+//remembers the check() result of every file by path, a result is reused only while both the file
+//identity (dev, inode, size, mtime) and the footer hash still match. the identity has to come from
+//the descriptor the data was read through, see file_identity::of(fd)
+struct validation_cache {
+    static constexpr uint32_t magic = 0x43564b50; //"PKVC"
+    static constexpr uint32_t version = 1;
+
+    struct entry {
+        file_identity identity;
+        uint64_t footer_hash;
+        std::string error;
+    };
+
+    std::string path;
+    std::unordered_map<std::string, entry> entries;
+    std::mutex mutex;
+    bool dirty = false;
+
+    //a missing or unreadable cache file just means starting from empty
+    explicit validation_cache(std::string path_): path(path_) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return;
+        }
+        uint32_t m = 0, v = 0, count = 0;
+        read_pod(in, m);
+        read_pod(in, v);
+        read_pod(in, count);
+        if (!in || m != magic || v != version) {
+            return;
+        }
+        for (uint32_t i = 0; i < count && in; i++) {
+            std::string filename = read_string(in);
+            entry e{};
+            read_pod(in, e.identity);
+            read_pod(in, e.footer_hash);
+            e.error = read_string(in);
+            if (in) {
+                entries.emplace(std::move(filename), std::move(e));
+            }
+        }
+    }
+
+    std::optional<std::string> lookup(const std::string& filename, const file_identity& identity, uint64_t hash) {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(filename);
+        if (it == entries.end() || it->second.identity != identity || it->second.footer_hash != hash) {
+            return std::nullopt;
+        }
+        return it->second.error;
+    }
+
+    void store(const std::string& filename, const file_identity& identity, uint64_t hash, const std::string& error) {
+        std::lock_guard lock(mutex);
+        entries[filename] = {identity, hash, error};
+        dirty = true;
+    }
+
+    //drops the entries of files that are gone, then writes the cache to a temporary file renamed over
+    //the old one so a crash never leaves half a cache
+    void save() {
+        std::lock_guard lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            struct stat st;
+            if (stat(it->first.c_str(), &st) < 0 && (errno == ENOENT || errno == ENOTDIR)) {
+                it = entries.erase(it);
+                dirty = true;
+            } else {
+                ++it;
+            }
+        }
+        if (!dirty) {
+            return;
+        }
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            write_pod(out, magic);
+            write_pod(out, version);
+            write_pod(out, static_cast<uint32_t>(entries.size()));
+            for (auto& [filename, e]: entries) {
+                write_string(out, filename);
+                write_pod(out, e.identity);
+                write_pod(out, e.footer_hash);
+                write_string(out, e.error);
+            }
+            if (!out) {
+                throw std::runtime_error(tmp + ": write failed");
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+        dirty = false;
+    }
+
+    template<typename T>
+    static void read_pod(std::istream& in, T& x) {
+        in.read(reinterpret_cast<char*>(&x), sizeof(x));
+    }
+
+    template<typename T>
+    static void write_pod(std::ostream& out, const T& x) {
+        out.write(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+
+    static std::string read_string(std::istream& in) {
+        uint32_t len = 0;
+        read_pod(in, len);
+        if (len > 1 << 20) {
+            in.setstate(std::ios::failbit);
+        }
+        std::string s(in ? len : 0, '\0');
+        in.read(s.data(), s.size());
+        return s;
+    }
+
+    static void write_string(std::ostream& out, std::string_view s) {
+        write_pod(out, static_cast<uint32_t>(s.size()));
+        out.write(s.data(), s.size());
+    }
+};